@@ -15,6 +15,8 @@
 #include "rpc/error.h"
 #include "utils/log.h"
 #include "utils/meta.h"
+#include "utils/metrics.h"
+#include "utils/trace.h"
 #include "model/address.h"
 
 #include "geocoder.h"
@@ -62,8 +64,15 @@ geocoder::geocoder(
 
 address_components geocoder::decompose(std::string text) const
 {
+  static auto& inference_time = metrics::registry::instance().add_histogram(
+    "geocoder_ner_duration_seconds", "Time spent in NER model inference");
+
   // invoke NER neural network and return labels tensor
-  auto tensor = geomodel_(text);
+  auto tensor = [&]() {
+    metrics::stopwatch timing(inference_time);
+    trace::span section("geocoder.ner");
+    return geomodel_(text);
+  }();
   
   // convert torch tensor to STL vector of labels
   std::vector<address_label> labels(static_cast<size_t>(tensor.size(0)));
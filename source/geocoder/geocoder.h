@@ -8,6 +8,7 @@
 #include "ner/geomodel.h"
 #include "spacial/index.h"
 #include "import/map_source.h"
+#include "utils/json_encode.h"
 
 // notes:
 //  metrics to be collected:
@@ -28,6 +29,18 @@ struct address_components
   std::optional<std::string> zipcode;
 };
 
+/**
+ * Components are written only if they are known.
+ */
+constexpr auto json_fields(address_components const*)
+{
+  return std::make_tuple(
+    json::field("city", &address_components::city),
+    json::field("street", &address_components::street),
+    json::field("building", &address_components::building),
+    json::field("zipcode", &address_components::zipcode));
+}
+
 /**
  * This is the type returned by all implementations of the geocoder backend as a
  * type that contains addressable exact matches and hints that are not addressable.
@@ -5,6 +5,7 @@
 #include "sqlite_fts.h"
 #include "utils/log.h"
 #include "utils/meta.h"
+#include "utils/trace.h"
 
 #include <boost/algorithm/string.hpp>
 
@@ -60,6 +61,11 @@ sqlite_backend::sqlite_backend(
     }
 
     regions_.emplace(source.name, handle);
+    query_time_.emplace(source.name, 
+      &metrics::registry::instance().add_histogram(
+        "geocoder_sqlite_query_duration_seconds", 
+        "Time spent querying the address book",
+        {{"region", source.name}}));
   }
 }
 
@@ -172,6 +178,8 @@ lookup_result sqlite_backend::lookup(
   address_components components) const
 {
   auto const& dbptr = regions_.at(region.name());
+  metrics::stopwatch timing(*query_time_.at(region.name()));
+  trace::span section("sqlite_fts.query");
 
   // remove all potentially dangerous characters that
   // might expose the underlying sqlite to sql injection.
@@ -10,6 +10,7 @@
 #include "rpc/service.h"
 #include "spacial/index.h"
 #include "geocoder/geocoder.h"
+#include "utils/metrics.h"
 
 namespace sentio::geocoder
 {
@@ -60,5 +61,6 @@ private:
 
 private:
   std::unordered_map<std::string, sqlite3_ptr> regions_;
+  std::unordered_map<std::string, metrics::histogram*> query_time_;
 };
 }
\ No newline at end of file
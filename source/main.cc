@@ -3,6 +3,7 @@
 // Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
 
 #include <list>
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <filesystem>
@@ -87,13 +88,13 @@ sentio::rpc::service_map_t create_services(
 
   sentio::rpc::service_map_t svcmap;
 
-  // svcmap.emplace("trip.poll",   
-  //   create_service(trip_service::poll(
-  //     systemconfig.get_child("routing"), worldix)));
+  svcmap.emplace("trip.poll",   
+    create_service(trip_service::poll(
+      systemconfig.get_child("routing"), worldix)));
 
-  // svcmap.emplace("trip.async",
-  //   create_service(trip_service::async(
-  //     systemconfig.get_child("routing"), worldix)));
+  svcmap.emplace("trip.async",
+    create_service(trip_service::async(
+      systemconfig.get_child("routing"), worldix)));
 
   svcmap.emplace("trip",
     create_service(trip_service::sync(
@@ -107,9 +108,131 @@ sentio::rpc::service_map_t create_services(
     create_service(distance_service(
       systemconfig.get_child("routing"), worldix, sources)));
 
+  svcmap.emplace("distance.matrix", 
+    create_service(distance_matrix_service(
+      systemconfig.get_child("routing"), worldix, sources)));
+
   return svcmap;
 }
 
+/**
+ * Reads a JSON object of name -> number pairs,
+ * used for per-method and per-region limits.
+ */
+std::unordered_map<std::string, size_t> read_limits(
+  json_t const& systemconfig, const char* path)
+{
+  std::unordered_map<std::string, size_t> output;
+  if (auto section = systemconfig.get_child_optional(path)) {
+    for (auto const& entry: section.value()) {
+      output.emplace(entry.first, entry.second.get_value<size_t>());
+    }
+  }
+  return output;
+}
+
+/**
+ * Reads the rate_limit sections of the identity providers listed in
+ * rpc.auth, e.g.:
+ *
+ *   "rate_limit": {
+ *     "rate": 20, "burst": 40,
+ *     "methods": { "trip": { "rate": 1, "burst": 10 } }
+ *   }
+ *
+ * Rates have to be positive and bursts at least one call, the burst
+ * defaults to one second worth of calls.
+ */
+std::unordered_map<std::string, sentio::rpc::provider_limits>
+read_rate_limits(json_t const& systemconfig)
+{
+  using sentio::rpc::rate_limit;
+  auto read_limit = [](json_t const& section) {
+    auto rate = section.get<double>("rate");
+    auto limit = rate_limit {
+      .rate = rate,
+      .burst = section.get<double>("burst", std::max(1.0, rate))
+    };
+    if (!(limit.rate > 0)) {
+      throw std::invalid_argument("rate limits need a positive rate");
+    }
+    if (!(limit.burst >= 1)) {
+      throw std::invalid_argument("rate limits need a burst of at least 1");
+    }
+    return limit;
+  };
+
+  std::unordered_map<std::string, sentio::rpc::provider_limits> output;
+  for (auto const& provider: systemconfig.get_child("rpc.auth")) {
+    auto section = provider.second.get_child_optional("rate_limit");
+    if (!section.has_value()) {
+      continue;
+    }
+
+    sentio::rpc::provider_limits limits;
+    if (section->get_optional<double>("rate").has_value()) {
+      limits.account = read_limit(section.value());
+    }
+    if (auto methods = section->get_child_optional("methods")) {
+      for (auto const& method: methods.value()) {
+        limits.methods.emplace(method.first, read_limit(method.second));
+      }
+    }
+    output.emplace(provider.second.get<std::string>("name"), std::move(limits));
+  }
+  return output;
+}
+
+/**
+ * Reads the list of network interfaces from rpc.interfaces, or falls back
+ * to a single interface serving both HTTP and WebSockets on rpc.address
+ * and rpc.port when the section is missing.
+ */
+std::vector<sentio::rpc::interface> read_interfaces(json_t const& systemconfig)
+{
+  using sentio::rpc::interface;
+  auto http_timeout = std::chrono::seconds(
+    systemconfig.get<uint32_t>("rpc.keepalive.idle_timeout", 30));
+
+  std::vector<interface> output;
+  auto section = systemconfig.get_child_optional("rpc.interfaces");
+  if (!section.has_value() || section->empty()) {
+    output.emplace_back(interface {
+      .type = interface::protocol::any,
+      .address = systemconfig.get<std::string>("rpc.address"),
+      .port = systemconfig.get<uint16_t>("rpc.port"),
+      .threads = 0,
+      .idle_timeout = http_timeout
+    });
+    return output;
+  }
+
+  for (auto const& child: section.value()) {
+    auto const& entry = child.second;
+    auto type = entry.get<std::string>("type");
+    interface iface {
+      .type = interface::protocol::http,
+      .address = entry.get<std::string>("address"),
+      .port = entry.get<uint16_t>("port"),
+      .threads = entry.get<size_t>("threads", 0),
+      .idle_timeout = http_timeout
+    };
+
+    if (boost::iequals(type, "ws+jsonrpc")) {
+      iface.type = interface::protocol::websocket;
+      iface.idle_timeout = std::chrono::seconds(300);
+    } else if (!boost::iequals(type, "http+jsonrpc")) {
+      throw std::invalid_argument("unsupported interface type: " + type);
+    }
+
+    if (auto timeout = entry.get_optional<uint32_t>("idle_timeout")) {
+      iface.idle_timeout = std::chrono::seconds(timeout.value());
+    }
+    output.emplace_back(std::move(iface));
+  }
+  return output;
+}
+
 std::thread start_worker_server(
   boost::property_tree::ptree const& systemconfig,
   std::vector<sentio::import::region_paths> const& sources)
@@ -174,8 +297,66 @@ int main(int argc, const char** argv)
 
     // this is the set of configs needed to expose JSON-RPC endpoints over http.
     sentio::rpc::config rpcconfig{
-      .listen_ip = systemconfig.get<std::string>("rpc.address"),
-      .listen_port = systemconfig.get<uint16_t>("rpc.port"),
+      .interfaces = read_interfaces(systemconfig),
+      .keepalive_max_requests = 
+        systemconfig.get<size_t>("rpc.keepalive.max_requests", 1000),
+      .write_timeout = std::chrono::seconds(
+        systemconfig.get<uint32_t>("rpc.keepalive.write_timeout", 30)),
+      .batch = {
+        .max_size = systemconfig.get<size_t>("rpc.batch.max_size", 50),
+        .max_cost = systemconfig.get<size_t>("rpc.batch.max_cost", 1000)},
+      .execution = {
+        .compute_threads = systemconfig.get<size_t>(
+          "rpc.execution.compute_threads", std::thread::hardware_concurrency()),
+        .blocking_threads = systemconfig.get<size_t>(
+          "rpc.execution.blocking_threads", 32)},
+      .sharding = {
+        .enabled = systemconfig.get<bool>("rpc.sharding.enabled", false),
+        .pin_threads = systemconfig.get<bool>("rpc.sharding.pin_threads", false),
+        .shards = systemconfig.get<size_t>("rpc.sharding.shards", 0)},
+      .websocket = {
+        .max_inflight = systemconfig.get<size_t>("rpc.websocket.max_inflight", 16),
+        .max_message_size = systemconfig.get<size_t>(
+          "rpc.websocket.max_message_size", 16 * 1024 * 1024),
+        .fragment_size = systemconfig.get<size_t>(
+          "rpc.websocket.fragment_size", 64 * 1024),
+        .deflate = {
+          .enabled = systemconfig.get<bool>(
+            "rpc.websocket.deflate.enabled", true),
+          .window_bits = systemconfig.get<int>(
+            "rpc.websocket.deflate.window_bits", 15),
+          .mem_level = systemconfig.get<int>(
+            "rpc.websocket.deflate.mem_level", 4),
+          .comp_level = systemconfig.get<int>(
+            "rpc.websocket.deflate.comp_level", 3),
+          .server_no_context_takeover = systemconfig.get<bool>(
+            "rpc.websocket.deflate.server_no_context_takeover", false),
+          .client_no_context_takeover = systemconfig.get<bool>(
+            "rpc.websocket.deflate.client_no_context_takeover", false)}},
+      .compression = {
+        .enabled = systemconfig.get<bool>("rpc.compression.enabled", true),
+        .min_size = systemconfig.get<size_t>("rpc.compression.min_size", 1024),
+        .level = systemconfig.get<int>("rpc.compression.level", 6),
+        .zstd_level = systemconfig.get<int>("rpc.compression.zstd_level", 3)},
+      .tracing = {
+        .server_timing = systemconfig.get<bool>("rpc.tracing.server_timing", false),
+        .sample_rate = systemconfig.get<double>("rpc.tracing.sample_rate", 0),
+        .file = systemconfig.get<std::string>("rpc.tracing.file", ""),
+        .queue_size = systemconfig.get<size_t>("rpc.tracing.queue_size", 1024)},
+      .admission = {
+        .enabled = systemconfig.get<bool>("rpc.admission.enabled", false),
+        .method_limit = systemconfig.get<size_t>("rpc.admission.method_limit", 0),
+        .region_limit = systemconfig.get<size_t>("rpc.admission.region_limit", 0),
+        .methods = read_limits(systemconfig, "rpc.admission.methods"),
+        .regions = read_limits(systemconfig, "rpc.admission.regions"),
+        .queue_size = systemconfig.get<size_t>("rpc.admission.queue_size", 256),
+        .queue_timeout = std::chrono::milliseconds(
+          systemconfig.get<uint32_t>("rpc.admission.queue_timeout_ms", 2000)),
+        .retry_after = std::chrono::seconds(
+          systemconfig.get<uint32_t>("rpc.admission.retry_after", 2))},
+      .coalescing = {
+        .enabled = systemconfig.get<bool>("rpc.coalescing.enabled", true)},
+      .rate_limits = read_rate_limits(systemconfig),
       .guard = systemconfig.get_child("rpc.auth")};
 
     // depending on the enabled roles for this instance, this
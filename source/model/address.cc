@@ -34,6 +34,21 @@ building building::from_json(json_t const& b)
   };
 }
 
+building tag_invoke(
+  boost::json::value_to_tag<building>, 
+  boost::json::value const& v)
+{
+  return model::building{
+    .id = json::to_int64(json::at(v, "id")),
+    .coords = boost::json::value_to<spacial::coordinates>(json::at(v, "coords")),
+    .country = std::string(),
+    .city = json::to_string(json::at(v, "city")),
+    .zipcode = json::optional_string(v, "zipcode").value_or(""),
+    .street = json::to_string(json::at(v, "street")),
+    .number = json::to_string(json::at(v, "number"))
+  };
+}
+
 json_t building::to_json() const
 {
   json_t output;
@@ -10,6 +10,8 @@
 #include <aws/dynamodb/model/AttributeValue.h>
 
 #include "utils/json.h"
+#include "utils/json_decode.h"
+#include "utils/json_encode.h"
 #include "spacial/coords.h"
 
 namespace sentio::model
@@ -31,6 +33,28 @@ struct building
   json_t to_json() const;
 };
 
+/**
+ * Decodes a building from a parsed request, accepts the
+ * same fields as building::from_json.
+ */
+building tag_invoke(
+  boost::json::value_to_tag<building>, 
+  boost::json::value const& v);
+
+/**
+ * Writes a building in the same shape as building::to_json.
+ */
+constexpr auto json_fields(building const*)
+{
+  return std::make_tuple(
+    json::field("id", &building::id),
+    json::field("coords", &building::coords),
+    json::field("city", &building::city),
+    json::field("street", &building::street),
+    json::field("number", &building::number),
+    json::field("zipcode", &building::zipcode));
+}
+
 struct address : public building 
 {
   std::string suite;
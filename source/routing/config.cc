@@ -11,14 +11,26 @@ namespace sentio::routing
 
 config::config()
   : max_waypoints(500)
+  , max_matrix_locations(100)
   , async_threshold(15)
   , worker_concurrency(std::thread::hardware_concurrency())
   , algorithm(osrm::EngineConfig::Algorithm::CH)
+  , storage(storage_mode::memory)
+  , datastore("osrm-datastore")
+  , warmup{
+      .enabled = false,
+      .routes = 32,
+      .lock_pages = false}
+  , distance_cache{
+      .enabled = false,
+      .max_bytes = 64 * 1024 * 1024,
+      .ttl = 24 * 60 * 60}
 {
 }
 
 config::config(json_t const& json)
   : max_waypoints(json.get<uint64_t>("max_waypoints"))
+  , max_matrix_locations(json.get<uint64_t>("max_matrix_locations", 100))
   , async_threshold(json.get<uint64_t>("async_threshold"))
   , worker_concurrency(json.get<uint64_t>("worker_concurrency"))
 {
@@ -35,6 +47,27 @@ config::config(json_t const& json)
   } else {
     throw std::invalid_argument("unrecognized routing algorithm");
   }
+
+  auto storagestring = json.get<std::string>("storage", "memory");
+  if (boost::iequals(storagestring, "memory")) {
+    storage = storage_mode::memory;
+  } else if (boost::iequals(storagestring, "mmap")) {
+    storage = storage_mode::mmap;
+  } else if (boost::iequals(storagestring, "shared")) {
+    storage = storage_mode::shared;
+  } else {
+    throw std::invalid_argument("unrecognized routing storage mode");
+  }
+  datastore = json.get<std::string>("datastore", "osrm-datastore");
+
+  warmup.enabled = json.get<bool>("warmup.enabled", false);
+  warmup.routes = json.get<size_t>("warmup.routes", 32);
+  warmup.lock_pages = json.get<bool>("warmup.lock_pages", false);
+
+  distance_cache.enabled = json.get<bool>("distance_cache.enabled", false);
+  distance_cache.max_bytes = json.get<size_t>(
+    "distance_cache.max_bytes", 64 * 1024 * 1024);
+  distance_cache.ttl = json.get<uint64_t>("distance_cache.ttl", 24 * 60 * 60);
 }
 
 }
@@ -13,11 +13,54 @@ namespace sentio::routing
 {
 
 class config {
+public:
+  /**
+   * How region datasets are brought into memory by the engine:
+   *  - memory: read and copied into the heap of every process,
+   *  - mmap: mapped from the extracted files, so processes on the same
+   *    host share one copy in the page cache, which outlives restarts,
+   *  - shared: attached to a shared memory region that osrm-datastore
+   *    published under the name of the region. Restarts attach to it
+   *    without loading anything. Regions that aren't published yet are
+   *    published by running the @c datastore executable as
+   *    "osrm-datastore --dataset-name=<region> <region>.osrm". The
+   *    regions have to fit into /dev/shm and outlive this process.
+   */
+  enum class storage_mode { memory, mmap, shared };
+
 public:
   uint64_t max_waypoints;
+  uint64_t max_matrix_locations;
   uint64_t async_threshold;
   uint64_t worker_concurrency;
   osrm::EngineConfig::Algorithm algorithm;
+  storage_mode storage;
+  std::string datastore;
+
+  /**
+   * Engines are cold after loading, their graph pages fault in as the
+   * first queries touch them. When enabled, every engine is warmed up
+   * once it loads: mmap datasets are read into the page cache, and
+   * optionally locked there (which needs a large enough RLIMIT_MEMLOCK).
+   * Then a number of synthetic routes is run within the region.
+   */
+  struct {
+    bool enabled;
+    size_t routes;
+    bool lock_pages;
+  } warmup;
+
+  /**
+   * Travel costs between pairs of points are cached for all regions
+   * and routing methods, see routing::distance_cache. The cache takes
+   * at most max_bytes of memory and forgets entries after ttl seconds,
+   * which should be shorter than the interval between map updates.
+   */
+  struct {
+    bool enabled;
+    size_t max_bytes;
+    uint64_t ttl;
+  } distance_cache;
 
   config();
   config(json_t const& json);
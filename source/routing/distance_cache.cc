@@ -0,0 +1,199 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "distance_cache.h"
+
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+namespace sentio::routing
+{
+
+namespace // detail
+{
+  int32_t quantize(double degrees)
+  { return static_cast<int32_t>(std::lround(degrees * 1e5)); }
+
+  uint64_t mix(uint64_t h, uint64_t value)
+  {
+    h ^= value + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    return h;
+  }
+}
+
+distance_cache::distance_cache(size_t max_bytes, std::chrono::seconds ttl)
+  : shard_capacity_(std::max<size_t>(1, max_bytes / entry_size / shard_count))
+  , ttl_(ttl)
+  , hits_(metrics::registry::instance().add_counter(
+      "osrm_distance_cache_hits_total",
+      "Distance queries answered from the cache"))
+  , misses_(metrics::registry::instance().add_counter(
+      "osrm_distance_cache_misses_total",
+      "Distance queries that had to be routed"))
+  , evictions_(metrics::registry::instance().add_counter(
+      "osrm_distance_cache_evictions_total",
+      "Cached distances replaced to make room for new ones"))
+  , entries_(metrics::registry::instance().add_gauge(
+      "osrm_distance_cache_entries", "Distances in the cache"))
+{
+}
+
+size_t distance_cache::key_hash::operator()(key_type const& key) const
+{
+  uint64_t h = key.region;
+  for (auto p: key.points) {
+    h = mix(h, static_cast<uint32_t>(p));
+  }
+  return h;
+}
+
+distance_cache::key_type distance_cache::key_of(
+  std::string_view region,
+  spacial::coordinates const& from,
+  spacial::coordinates const& to)
+{
+  return key_type {
+    .region = std::hash<std::string_view>{}(region),
+    .points = {
+      quantize(from.latitude()), quantize(from.longitude()),
+      quantize(to.latitude()), quantize(to.longitude())
+    }
+  };
+}
+
+// the index hashes the whole key, shards are picked by
+// a different mix of it so that they stay independent.
+distance_cache::shard& distance_cache::shard_of(key_type const& key)
+{ return shards_[mix(key_hash{}(key), 0x51ed27) % shard_count]; }
+
+distance_cache::shard const& distance_cache::shard_of(key_type const& key) const
+{ return shards_[mix(key_hash{}(key), 0x51ed27) % shard_count]; }
+
+std::optional<travel_cost> distance_cache::lookup(
+  key_type const& key, clock::time_point now) const
+{
+  auto const& s = shard_of(key);
+
+  std::shared_lock lock(s.mutex);
+  auto it = s.index.find(key);
+  if (it == s.index.end() || s.slots[it->second].expires <= now) {
+    return std::nullopt;
+  }
+
+  auto const& entry = s.slots[it->second];
+  entry.referenced.store(true, std::memory_order_relaxed);
+  return entry.cost;
+}
+
+std::optional<travel_cost> distance_cache::find(
+  std::string_view region,
+  spacial::coordinates const& from,
+  spacial::coordinates const& to,
+  clock::time_point now) const
+{
+  auto cost = lookup(key_of(region, from, to), now);
+  if (cost.has_value()) {
+    hits_.add();
+  } else {
+    misses_.add();
+  }
+  return cost;
+}
+
+std::optional<std::vector<travel_cost>> distance_cache::find_all(
+  std::string_view region,
+  std::vector<spacial::coordinates> const& sources,
+  std::vector<spacial::coordinates> const& destinations,
+  clock::time_point now) const
+{
+  auto cells = sources.size() * destinations.size();
+  std::vector<travel_cost> output;
+  output.reserve(cells);
+
+  for (auto const& from: sources) {
+    for (auto const& to: destinations) {
+      auto cost = lookup(key_of(region, from, to), now);
+      if (!cost.has_value()) {
+        misses_.add(cells);
+        return std::nullopt;
+      }
+      output.push_back(*cost);
+    }
+  }
+  hits_.add(cells);
+  return output;
+}
+
+size_t distance_cache::evict(shard& s, clock::time_point now)
+{
+  // every referenced entry is spared once, so the
+  // hand stops within two rounds at the latest.
+  while (true) {
+    auto position = s.hand;
+    s.hand = (s.hand + 1) % s.slots.size();
+
+    auto& candidate = s.slots[position];
+    if (candidate.expires <= now ||
+        !candidate.referenced.exchange(false, std::memory_order_relaxed)) {
+      return position;
+    }
+  }
+}
+
+void distance_cache::insert(
+  std::string_view region,
+  spacial::coordinates const& from,
+  spacial::coordinates const& to,
+  travel_cost cost,
+  clock::time_point now)
+{
+  auto key = key_of(region, from, to);
+  auto& s = shard_of(key);
+
+  std::unique_lock lock(s.mutex);
+  if (auto it = s.index.find(key); it != s.index.end()) {
+    auto& entry = s.slots[it->second];
+    entry.cost = cost;
+    entry.expires = now + ttl_;
+    return;
+  }
+
+  if (s.slots.size() < shard_capacity_) {
+    auto& entry = s.slots.emplace_back();
+    entry.key = key;
+    entry.cost = cost;
+    entry.expires = now + ttl_;
+    s.index.emplace(key, s.slots.size() - 1);
+    entries_.add();
+    return;
+  }
+
+  auto position = evict(s, now);
+  auto& entry = s.slots[position];
+  s.index.erase(entry.key);
+  evictions_.add();
+
+  entry.key = key;
+  entry.cost = cost;
+  entry.expires = now + ttl_;
+  entry.referenced.store(false, std::memory_order_relaxed);
+  s.index.emplace(key, position);
+}
+
+size_t distance_cache::size() const
+{
+  size_t total = 0;
+  for (auto const& s: shards_) {
+    std::shared_lock lock(s.mutex);
+    total += s.index.size();
+  }
+  return total;
+}
+
+size_t distance_cache::capacity() const
+{ return shard_capacity_ * shard_count; }
+
+}
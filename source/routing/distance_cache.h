@@ -0,0 +1,150 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <array>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+#include "waypoint.h"
+#include "spacial/coords.h"
+#include "utils/metrics.h"
+
+namespace sentio::routing
+{
+
+/**
+ * Remembers travel costs between pairs of points. Deliveries start and
+ * end at the same depots and buildings day after day, so most distance
+ * queries were already answered before.
+ *
+ * Entries are keyed by the region and by both coordinates rounded to
+ * 1e-5 degrees, about a meter, so repeated queries for one place hit
+ * even when clients report it with slightly different precision. An
+ * entry is served until its time to live runs out.
+ *
+ * The table is split into shards with their own lock, lookups take a
+ * shared lock of one shard. Each shard holds a fixed number of entries,
+ * derived from the memory cap, and evicts with the CLOCK algorithm: hits
+ * mark an entry as referenced, and inserting into a full shard sweeps a
+ * hand over the entries, sparing referenced ones once, until it finds
+ * one to replace. Expired entries are replaced first.
+ */
+class distance_cache
+{
+public:
+  using clock = std::chrono::steady_clock;
+  static constexpr size_t shard_count = 16;
+
+  /**
+   * Upper bound of the memory taken by one entry,
+   * including its node in the shard index.
+   */
+  static constexpr size_t entry_size = 128;
+
+public:
+  distance_cache(size_t max_bytes, std::chrono::seconds ttl);
+
+public: // noncopyable
+  distance_cache(distance_cache const&) = delete;
+  distance_cache& operator=(distance_cache const&) = delete;
+
+public:
+  std::optional<travel_cost> find(
+    std::string_view region,
+    spacial::coordinates const& from,
+    spacial::coordinates const& to,
+    clock::time_point now = clock::now()) const;
+
+  /**
+   * Looks up the costs from every source to every destination, in row
+   * major order, and returns them only if all of them are cached. Cells
+   * count as hits only when the whole matrix is served, otherwise all
+   * of them are routed again and count as misses.
+   */
+  std::optional<std::vector<travel_cost>> find_all(
+    std::string_view region,
+    std::vector<spacial::coordinates> const& sources,
+    std::vector<spacial::coordinates> const& destinations,
+    clock::time_point now = clock::now()) const;
+
+  void insert(
+    std::string_view region,
+    spacial::coordinates const& from,
+    spacial::coordinates const& to,
+    travel_cost cost,
+    clock::time_point now = clock::now());
+
+  size_t size() const;
+  size_t capacity() const;
+
+private:
+  struct key_type
+  {
+    uint64_t region;
+    std::array<int32_t, 4> points;
+
+    bool operator==(key_type const&) const = default;
+  };
+
+  struct key_hash
+  {
+    size_t operator()(key_type const& key) const;
+  };
+
+  struct slot
+  {
+    key_type key;
+    travel_cost cost;
+    clock::time_point expires;
+    mutable std::atomic<bool> referenced{false};
+  };
+
+  struct alignas(64) shard
+  {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<key_type, size_t, key_hash> index;
+    std::deque<slot> slots;
+    size_t hand = 0;
+  };
+
+  static key_type key_of(
+    std::string_view region,
+    spacial::coordinates const& from,
+    spacial::coordinates const& to);
+
+  shard& shard_of(key_type const& key);
+  shard const& shard_of(key_type const& key) const;
+
+  /**
+   * Finds an entry that is still valid and marks it as referenced,
+   * without counting a hit or a miss.
+   */
+  std::optional<travel_cost> lookup(
+    key_type const& key, clock::time_point now) const;
+
+  /**
+   * Picks the slot to reuse in a full shard.
+   */
+  size_t evict(shard& s, clock::time_point now);
+
+private:
+  size_t shard_capacity_;
+  std::chrono::seconds ttl_;
+  std::array<shard, shard_count> shards_;
+  metrics::counter& hits_;
+  metrics::counter& misses_;
+  metrics::counter& evictions_;
+  metrics::gauge& entries_;
+};
+
+}
@@ -5,17 +5,27 @@
 #include <iostream>
 #include <execution>
 #include <algorithm>
+#include <filesystem>
+#include <system_error>
 #include <unordered_map>
 
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
 #include <osrm/osrm.hpp>
 #include <osrm/coordinate.hpp>
 #include <osrm/json_container.hpp>
 #include <osrm/trip_parameters.hpp>
+#include <osrm/table_parameters.hpp>
 
 #include "worker.h"
+#include "warmup.h"
 #include "waypoint.h"
 #include "osrm_interop.h"
 #include "utils/log.h"
+#include "utils/metrics.h"
+#include "utils/trace.h"
 
 void debug_trip(osrm::json::Object& trip, size_t i)
 {
@@ -77,12 +87,24 @@ public:
         .storage_config =
           osrm::storage::StorageConfig(source.osrm),
         .max_locations_trip = static_cast<int>(cfg.max_waypoints),
-        .use_shared_memory = false,
+        .max_locations_distance_table = 
+          static_cast<int>(cfg.max_matrix_locations),
+        .use_shared_memory = cfg.storage == config::storage_mode::shared,
         .memory_file = boost::filesystem::path(),
+        .use_mmap = cfg.storage == config::storage_mode::mmap,
         .algorithm = cfg.algorithm,
         .verbosity = "DEBUG",
         .dataset_name = source.name}
     , engineinstance_(engconfig_) 
+    , trip_time_(metrics::registry::instance().add_histogram(
+        "osrm_call_duration_seconds", "Time spent in the OSRM engine",
+        {{"region", source.name}, {"call", "trip"}}))
+    , route_time_(metrics::registry::instance().add_histogram(
+        "osrm_call_duration_seconds", "",
+        {{"region", source.name}, {"call", "route"}}))
+    , table_time_(metrics::registry::instance().add_histogram(
+        "osrm_call_duration_seconds", "",
+        {{"region", source.name}, {"call", "table"}}))
     {
       dbglog << "created routing engine instance for " 
             << source.name << " using index: "
@@ -184,10 +206,15 @@ public:
     }
 
     osrm::engine::api::ResultT result = osrm::json::Object();
-    const auto status = engineinstance_.Trip(tparams, result);
+    auto const status = [&]() {
+      metrics::stopwatch timing(trip_time_);
+      trace::span section("osrm.trip");
+      return engineinstance_.Trip(tparams, result);
+    }();
     auto& json_result = result.get<osrm::json::Object>();
     auto const& returncode = json_result.values["code"].get<osrm::json::String>().value;
     if (status == osrm::Status::Ok && boost::iequals(returncode, "ok")) {
+      trace::span section("osrm.map_trip");
       auto waypointsorder = map_waypoints_order(json_result);
       return optimized_trip(
         trip, waypointsorder,
@@ -206,7 +233,10 @@ public:
     spacial::coordinates const& from,
     spacial::coordinates const& to) const
   {
+    // only the summary is used, the geometry would be
+    // computed and encoded for nothing.
     osrm::RouteParameters rparams;
+    rparams.overview = osrm::RouteParameters::OverviewType::False;
     
     rparams.coordinates.push_back({
       osrm::util::FloatLongitude { from.longitude() },
@@ -219,7 +249,11 @@ public:
     });
     
     osrm::engine::api::ResultT result = osrm::json::Object();
-    const auto status = engineinstance_.Route(rparams, result);
+    auto const status = [&]() {
+      metrics::stopwatch timing(route_time_);
+      trace::span section("osrm.route");
+      return engineinstance_.Route(rparams, result);
+    }();
     if (status == osrm::Status::Ok) {
       
       auto& route = result.get<osrm::json::Object>()
@@ -243,9 +277,90 @@ public:
     
   }
 
+  /**
+   * Converts one annotation of the table response, an array of rows
+   * of numbers, or nulls for pairs that have no route between them.
+   */
+  static std::vector<int32_t> map_table(
+    osrm::json::Object& json_result, 
+    const char* annotation,
+    size_t rows, size_t columns)
+  {
+    std::vector<int32_t> output;
+    output.reserve(rows * columns);
+    auto& table = json_result.values[annotation]
+      .get<osrm::json::Array>().values;
+    for (auto& row: table) {
+      for (auto& cell: row.get<osrm::json::Array>().values) {
+        output.push_back(cell.is<osrm::json::Number>()
+          ? static_cast<int32_t>(cell.get<osrm::json::Number>().value)
+          : -1);
+      }
+    }
+
+    if (output.size() != rows * columns) {
+      throw std::runtime_error("malformed distance table");
+    }
+    return output;
+  }
+
+  travel_matrix calculate_matrix(
+    std::vector<spacial::coordinates> const& sources,
+    std::vector<spacial::coordinates> const& destinations,
+    bool with_distances) const
+  {
+    // all coordinates go into one list, sources and
+    // destinations refer to them by their index.
+    osrm::TableParameters tparams;
+    for (auto const* points: { &sources, &destinations }) {
+      for (auto const& point: *points) {
+        tparams.coordinates.push_back({
+          osrm::util::FloatLongitude { point.longitude() },
+          osrm::util::FloatLatitude { point.latitude() }
+        });
+      }
+    }
+    for (size_t i = 0; i < sources.size(); ++i) {
+      tparams.sources.push_back(i);
+    }
+    for (size_t i = 0; i < destinations.size(); ++i) {
+      tparams.destinations.push_back(sources.size() + i);
+    }
+    tparams.annotations = with_distances
+      ? osrm::TableParameters::AnnotationsType::All
+      : osrm::TableParameters::AnnotationsType::Duration;
+
+    osrm::engine::api::ResultT result = osrm::json::Object();
+    auto const status = [&]() {
+      metrics::stopwatch timing(table_time_);
+      trace::span section("osrm.table");
+      return engineinstance_.Table(tparams, result);
+    }();
+    if (status != osrm::Status::Ok) {
+      throw std::runtime_error("distance table failed");
+    }
+
+    auto& json_result = result.get<osrm::json::Object>();
+    travel_matrix output {
+      .rows = sources.size(),
+      .columns = destinations.size(),
+      .durations = map_table(json_result, "durations", 
+        sources.size(), destinations.size()),
+      .distances = {}
+    };
+    if (with_distances) {
+      output.distances = map_table(json_result, "distances",
+        sources.size(), destinations.size());
+    }
+    return output;
+  }
+
 private:
   osrm::EngineConfig engconfig_;
   osrm::OSRM engineinstance_;
+  metrics::histogram& trip_time_;
+  metrics::histogram& route_time_;
+  metrics::histogram& table_time_;
 };
 
 osrm_instance::~osrm_instance() = default;
@@ -261,16 +376,207 @@ travel_cost osrm_instance::calculate_distance(
     spacial::coordinates const& to) const
 { return impl_->calculate_distance(from, to); }
 
+travel_matrix osrm_instance::calculate_matrix(
+    std::vector<spacial::coordinates> const& sources,
+    std::vector<spacial::coordinates> const& destinations,
+    bool with_distances) const
+{ return impl_->calculate_matrix(sources, destinations, with_distances); }
+
+namespace // detail
+{
+  const char* name_of(config::storage_mode mode)
+  {
+    switch (mode) {
+      case config::storage_mode::memory: return "memory";
+      case config::storage_mode::mmap: return "mmap";
+      case config::storage_mode::shared: return "shared";
+    }
+    return "unknown";
+  }
+
+  /**
+   * Total size of the files of an OSRM dataset, 
+   * all of which the engine loads into memory.
+   */
+  uint64_t dataset_size(std::string const& basepath)
+  {
+    uint64_t total = 0;
+    std::error_code ec;
+    for (auto const& file: dataset_files(basepath)) {
+      auto size = std::filesystem::file_size(file, ec);
+      total += ec ? 0 : size;
+    }
+    return total;
+  }
+
+  /**
+   * Runs osrm-datastore to load a dataset into a shared memory
+   * region named after its region. Blocks until it's published.
+   */
+  void publish_dataset(
+    std::string const& datastore,
+    import::region_paths const& source)
+  {
+    auto name = "--dataset-name=" + source.name;
+    std::vector<char*> argv {
+      const_cast<char*>(datastore.c_str()),
+      const_cast<char*>(name.c_str()),
+      const_cast<char*>(source.osrm.c_str()),
+      nullptr
+    };
+
+    pid_t pid;
+    if (int err = ::posix_spawnp(
+          &pid, datastore.c_str(), nullptr, nullptr, argv.data(), environ);
+        err != 0) {
+      throw std::system_error(err, std::generic_category(),
+        "failed to run " + datastore);
+    }
+
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      throw std::runtime_error(
+        "osrm-datastore failed to publish " + source.name);
+    }
+  }
+
+  /**
+   * Creates the engine of a region. Shared datasets that nobody has
+   * published yet are published first, later restarts attach to them.
+   */
+  std::unique_ptr<osrm_instance> load_engine(
+    config const& config,
+    import::region_paths const& source)
+  {
+    if (config.storage != config::storage_mode::shared) {
+      return std::make_unique<osrm_instance>(config, source);
+    }
+
+    try {
+      return std::make_unique<osrm_instance>(config, source);
+    } catch (std::exception const& e) {
+      infolog << "no shared dataset for " << source.name << " ("
+              << e.what() << "), publishing it with " << config.datastore;
+    }
+    publish_dataset(config.datastore, source);
+    return std::make_unique<osrm_instance>(config, source);
+  }
+}
+
+engine_registry& engine_registry::instance()
+{
+  static engine_registry engines;
+  return engines;
+}
+
+std::shared_ptr<osrm_instance const> engine_registry::acquire(
+  config const& config,
+  import::region_paths const& source)
+{
+  // the engine is configured with these, users that
+  // differ in them can't share one.
+  auto key = source.osrm 
+    + "#" + std::to_string(static_cast<int>(config.algorithm))
+    + "#" + std::to_string(config.max_waypoints)
+    + "#" + std::to_string(config.max_matrix_locations)
+    + "#" + name_of(config.storage);
+
+  std::shared_ptr<entry> slot;
+  {
+    std::lock_guard lock(mutex_);
+    auto& found = entries_[key];
+    if (!found) {
+      found = std::make_shared<entry>();
+    }
+    slot = found;
+  }
+
+  // concurrent users of a region wait for the first one to load it
+  std::lock_guard loading(slot->loading);
+  if (auto engine = slot->engine.lock()) {
+    dbglog << "sharing routing engine instance for " << source.name;
+    return engine;
+  }
+
+  // shared regions are owned by osrm-datastore, this
+  // process doesn't hold a copy of the dataset.
+  auto storage = name_of(config.storage);
+  bool owned = config.storage != config::storage_mode::shared;
+  auto size = owned ? static_cast<int64_t>(dataset_size(source.osrm)) : 0;
+  auto loaded = owned 
+    ? &metrics::registry::instance().add_gauge(
+        "osrm_dataset_bytes", "Size of the OSRM datasets in use",
+        {{"region", source.name}, {"storage", storage}})
+    : nullptr;
+  auto& startup = metrics::registry::instance().add_histogram(
+    "osrm_engine_load_duration_seconds",
+    "Time to load or attach to the OSRM dataset of a region",
+    {{"region", source.name}, {"storage", storage}});
+
+  // cold starts read the dataset from disk, warm starts find it in
+  // the page cache (mmap) or in a published shared memory region.
+  auto started = std::chrono::steady_clock::now();
+  auto instance = load_engine(config, source);
+  auto elapsed = std::chrono::steady_clock::now() - started;
+  startup.record(elapsed);
+  infolog << "loaded routing engine for " << source.name << " ("
+          << (owned ? std::to_string(size / (1024 * 1024)) + " MiB, " : "")
+          << storage << ") in "
+          << std::chrono::duration_cast<
+               std::chrono::milliseconds>(elapsed).count() << "ms";
+
+  // nobody gets the engine before it is warm, the rpc server
+  // starts listening only once all services have their engines.
+  std::shared_ptr<void> pinned;
+  if (config.warmup.enabled) {
+    pinned = warm_up(*instance, config, source);
+  }
+
+  auto engine = std::shared_ptr<osrm_instance const>(
+    instance.release(),
+    [loaded, size, pinned](osrm_instance const* released) {
+      delete released;
+      if (loaded != nullptr) {
+        loaded->sub(size);
+      }
+    });
+  if (loaded != nullptr) {
+    loaded->add(size);
+  }
+  slot->engine = engine;
+  return engine;
+}
+
+std::shared_ptr<distance_cache> engine_registry::shared_cache(
+  config const& config)
+{
+  std::lock_guard lock(mutex_);
+  if (!cache_.has_value()) {
+    if (config.distance_cache.enabled) {
+      cache_ = std::make_shared<distance_cache>(
+        config.distance_cache.max_bytes,
+        std::chrono::seconds(config.distance_cache.ttl));
+      infolog << "caching up to " << (*cache_)->capacity() 
+              << " travel costs for " << config.distance_cache.ttl << "s";
+    } else {
+      cache_ = nullptr;
+    }
+  }
+  return *cache_;
+}
+
 class osrm_map::impl {
 public:
   impl(config const& config, std::vector<import::region_paths> const& sources)
+    : cache_(engine_registry::instance().shared_cache(config))
   {
     std::mutex instsync;
     std::for_each(
       sources.begin(), sources.end(),
       [this, &config, &instsync](auto const& source) {
         try {
-          auto instance = osrm_instance(config, source);
+          auto instance = engine_registry::instance().acquire(config, source);
           std::lock_guard g(instsync);
           instances_.emplace(source.name, std::move(instance));
         } catch (std::exception const& e) {
@@ -290,7 +596,7 @@ public:
     if (instanceit == instances_.end()) {
       throw std::runtime_error("invalid region");
     }
-    return instanceit->second.optimize_trip(std::move(trip));
+    return instanceit->second->optimize_trip(std::move(trip));
   }
 
   travel_cost calculate_distance(
@@ -302,11 +608,102 @@ public:
     if (instanceit == instances_.end()) {
       throw std::runtime_error("invalid region");
     }
-    return instanceit->second.calculate_distance(from, to);
+
+    if (!cache_) {
+      return instanceit->second->calculate_distance(from, to);
+    }
+
+    if (auto cached = cache_->find(region, from, to)) {
+      return *cached;
+    }
+    auto cost = instanceit->second->calculate_distance(from, to);
+    cache_->insert(region, from, to, cost);
+    return cost;
+  }
+
+  travel_matrix calculate_matrix(
+    std::vector<spacial::coordinates> const& sources,
+    std::vector<spacial::coordinates> const& destinations,
+    std::string const& region,
+    bool with_distances) const
+  {
+    auto instanceit = instances_.find(region);
+    if (instanceit == instances_.end()) {
+      throw std::runtime_error("invalid region");
+    }
+
+    if (!cache_) {
+      return instanceit->second->calculate_matrix(
+        sources, destinations, with_distances);
+    }
+
+    if (auto cached = cached_matrix(
+          sources, destinations, region, with_distances)) {
+      return std::move(*cached);
+    }
+
+    auto output = instanceit->second->calculate_matrix(
+      sources, destinations, with_distances);
+
+    // durations alone are not enough for an entry, and
+    // pairs without a route are asked for again.
+    if (with_distances) {
+      for (size_t i = 0; i < output.rows; ++i) {
+        for (size_t j = 0; j < output.columns; ++j) {
+          auto cell = i * output.columns + j;
+          if (output.durations[cell] < 0 || output.distances[cell] < 0) {
+            continue;
+          }
+          cache_->insert(region, sources[i], destinations[j], travel_cost {
+            .distance = output.distances[cell],
+            .duration = std::chrono::seconds(output.durations[cell])
+          });
+        }
+      }
+    }
+    return output;
+  }
+
+private:
+  /**
+   * Assembles the matrix from the cache if all of its cells are there,
+   * a single table query is cheaper than routing the missing ones.
+   */
+  std::optional<travel_matrix> cached_matrix(
+    std::vector<spacial::coordinates> const& sources,
+    std::vector<spacial::coordinates> const& destinations,
+    std::string const& region,
+    bool with_distances) const
+  {
+    auto cached = cache_->find_all(region, sources, destinations);
+    if (!cached.has_value()) {
+      return std::nullopt;
+    }
+
+    travel_matrix output {
+      .rows = sources.size(),
+      .columns = destinations.size(),
+      .durations = {},
+      .distances = {}
+    };
+    output.durations.reserve(cached->size());
+    if (with_distances) {
+      output.distances.reserve(cached->size());
+    }
+
+    for (auto const& cost: *cached) {
+      output.durations.push_back(static_cast<int32_t>(cost.duration.count()));
+      if (with_distances) {
+        output.distances.push_back(cost.distance);
+      }
+    }
+    return output;
   }
 
 private:
-  std::unordered_map<std::string, osrm_instance> instances_;
+  std::shared_ptr<distance_cache> cache_;
+  std::unordered_map<std::string,
+    std::shared_ptr<osrm_instance const>> instances_;
 };
 
 osrm_map::~osrm_map() = default;
@@ -324,5 +721,15 @@ travel_cost osrm_map::calculate_distance(
     std::string const& region) const
 { return impl_->calculate_distance(from, to, region); }
 
+travel_matrix osrm_map::calculate_matrix(
+    std::vector<spacial::coordinates> const& sources,
+    std::vector<spacial::coordinates> const& destinations,
+    std::string const& region,
+    bool with_distances) const
+{ 
+  return impl_->calculate_matrix(
+    sources, destinations, region, with_distances); 
+}
+
 } // namespace sentio::routing
 
@@ -4,9 +4,14 @@
 
 #pragma once
 
+#include <map>
+#include <mutex>
 #include <memory>
+#include <string>
+#include <optional>
 
 #include "trip.h"
+#include "distance_cache.h"
 #include "import/map_source.h"
 
 namespace sentio::routing
@@ -35,6 +40,10 @@ public:
   travel_cost calculate_distance(
     spacial::coordinates const& from,
     spacial::coordinates const& to) const;
+  travel_matrix calculate_matrix(
+    std::vector<spacial::coordinates> const& sources,
+    std::vector<spacial::coordinates> const& destinations,
+    bool with_distances) const;
 
 public:
   osrm_instance(osrm_instance&&) = default;
@@ -45,12 +54,62 @@ private:
   std::unique_ptr<impl> impl_;
 };
 
+/**
+ * Shares routing engines between all their users in the process.
+ *
+ * The trip and distance services and the routing worker each route
+ * over the same regions. Instead of loading its own copy of a region
+ * dataset, each of them acquires the engine from this registry, which
+ * loads it on first use and keeps it for as long as someone holds a
+ * reference. Engines answer concurrent queries, so one is enough.
+ *
+ * The size of every loaded dataset is reported per region in the
+ * osrm_dataset_bytes gauge, and the time it took to load or attach
+ * to it in osrm_engine_load_duration_seconds.
+ */
+class engine_registry
+{
+public:
+  static engine_registry& instance();
+
+public:
+  /**
+   * Returns the engine for the region, loading it if it is not held
+   * by anyone yet. Engines of different regions load concurrently.
+   */
+  std::shared_ptr<osrm_instance const> acquire(
+    config const& config,
+    import::region_paths const& source);
+
+  /**
+   * Returns the distance cache shared by all routing methods and all
+   * regions, created with the config of the first caller. Returns
+   * nullptr if that config has the cache disabled.
+   */
+  std::shared_ptr<distance_cache> shared_cache(config const& config);
+
+private:
+  struct entry
+  {
+    std::mutex loading;
+    std::weak_ptr<osrm_instance const> engine;
+  };
+
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<entry>> entries_;
+  std::optional<std::shared_ptr<distance_cache>> cache_;
+};
+
 /**
  * Wraps a map of region_name <--> osrm instance and routes
  * trip requests to the appropriate instance of the OSRM 
  * engine based on the region. Right now we are just trusting
  * the region name from the metadata field in the trip request
  * in SQS, however other slicing algorithms might be expected.
+ *
+ * Instances are acquired from the engine_registry, so maps over
+ * the same regions share their engines. Travel costs go through the
+ * shared distance cache when it is enabled.
  */
 class osrm_map 
 {
@@ -69,6 +128,12 @@ public:
     spacial::coordinates const& to,
     std::string const& region) const;
 
+  travel_matrix calculate_matrix(
+    std::vector<spacial::coordinates> const& sources,
+    std::vector<spacial::coordinates> const& destinations,
+    std::string const& region,
+    bool with_distances) const;
+
 private:
   class impl;
   std::shared_ptr<impl> impl_;
@@ -17,6 +17,7 @@
 #include "scheduler.h"
 #include "utils/log.h"
 #include "utils/aws.h"
+#include "utils/aws_async.h"
 
 namespace sentio::routing
 {
@@ -31,7 +32,9 @@ json_t trip_promise::to_json() const
   return output;
 }
 
-scheduler::scheduler() {}
+scheduler::scheduler() 
+  : sqs_(aws::client_config()) 
+{}
 
 size_t scheduler::pending_promises() const 
 {  
@@ -51,10 +54,8 @@ size_t scheduler::pending_promises() const
   }
 }
 
-trip_promise scheduler::schedule_trip(trip_request t) const 
+static Aws::SQS::Model::SendMessageRequest make_message(trip_request const& t)
 {
-  using namespace boost::posix_time;
-
   Aws::SQS::Model::SendMessageRequest queuemsg;
   queuemsg.SetQueueUrl(aws::resources().queues.pending_routes);
   
@@ -66,8 +67,13 @@ trip_promise scheduler::schedule_trip(trip_request t) const
     errlog << e.what();
     throw;
   }
-  auto result = sqs_.SendMessage(queuemsg);
+  return queuemsg;
+}
 
+static trip_promise make_promise(
+  Aws::SQS::Model::SendMessageOutcome const& result)
+{
+  using namespace boost::posix_time;
   if (result.IsSuccess()) {
     return trip_promise {
       .id = result.GetResult().GetMessageId(),
@@ -80,6 +86,20 @@ trip_promise scheduler::schedule_trip(trip_request t) const
   }
 }
 
+trip_promise scheduler::schedule_trip(trip_request t) const 
+{
+  return make_promise(sqs_.SendMessage(make_message(t)));
+}
+
+boost::asio::awaitable<trip_promise> 
+scheduler::schedule_trip_async(trip_request t) const
+{
+  auto queuemsg = make_message(t);
+  co_return make_promise(
+    co_await aws::async_call<Aws::SQS::Model::SendMessageOutcome>(
+      [&](auto const& done) { sqs_.SendMessageAsync(queuemsg, done); }));
+}
+
 void delete_message(std::string receipthandle, Aws::SQS::SQSClient const& sqs)
 {
   Aws::SQS::Model::DeleteMessageRequest delmsg;
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <string> 
+#include <boost/asio/awaitable.hpp>
 
 #include "trip.h"
 
@@ -72,6 +73,12 @@ public:
    */
   trip_promise schedule_trip(trip_request) const;
 
+  /**
+   * Same as @c schedule_trip, but suspends the awaiting coroutine
+   * instead of blocking its thread while SQS stores the message.
+   */
+  boost::asio::awaitable<trip_promise> schedule_trip_async(trip_request) const;
+
   /**
    * Gets next available trip routing request off the scheduler 
    * queue, and makes it invisible for other workers for about 10 seconds.
@@ -96,6 +96,27 @@ unoptimized_trip::unoptimized_trip(json_t body)
       waypoints_from_json_list(body.get_child("waypoints")))
 {}
 
+unoptimized_trip tag_invoke(
+  boost::json::value_to_tag<unoptimized_trip>,
+  boost::json::value const& v)
+{
+  auto const* wps = json::at(v, "waypoints").if_array();
+  if (wps == nullptr) {
+    throw std::invalid_argument("waypoints must be an array");
+  }
+
+  unoptimized_trip::waypoints_container waypoints;
+  waypoints.reserve(wps->size());
+  for (auto const& wp: *wps) {
+    waypoints.emplace_back(boost::json::value_to<waypoint>(wp));
+  }
+
+  return unoptimized_trip(
+    boost::json::value_to<waypoint>(json::at(v, "starting_point")),
+    boost::json::value_to<waypoint>(json::at(v, "final_point")),
+    std::move(waypoints));
+}
+
 bool unoptimized_trip::roundtrip() const
 { return starting_waypoint().building.id == final_waypoint().building.id; }
 
@@ -236,6 +257,18 @@ trip_metadata::trip_metadata(json_t const& json)
 {
 }
 
+trip_metadata::trip_metadata(
+  std::string region,
+  std::string accountid,
+  date_time_t createdat,
+  std::optional<std::string> id)
+  : region_(std::move(region))
+  , accountid_(std::move(accountid))
+  , createdat_(createdat)
+  , id_(std::move(id))
+{
+}
+
 std::optional<std::string> const& trip_metadata::id() const
 { return id_; }
 
@@ -267,10 +300,25 @@ json_t trip_metadata::to_json() const
 //
 
 trip_request::trip_request(json_t b)
-  : body_(std::move(b))
-  , trip_(body_)
-  , metadata_(body_.get_child("meta"))
-  , location_(spacial::coordinates::from_json(body_.get_child("location")))
+  : trip_(b)
+  , metadata_(b.get_child("meta"))
+  , location_(spacial::coordinates::from_json(b.get_child("location")))
+{
+  verify();
+}
+
+trip_request::trip_request(
+  unoptimized_trip trip,
+  trip_metadata metadata,
+  spacial::coordinates location)
+  : trip_(std::move(trip))
+  , metadata_(std::move(metadata))
+  , location_(std::move(location))
+{
+  verify();
+}
+
+void trip_request::verify() const
 {
   verify_argument(!meta().region().empty());
   verify_argument(!meta().accountid().empty());
@@ -289,8 +337,13 @@ spacial::coordinates const& trip_request::location() const
 unoptimized_trip const& trip_request::trip() const
 { return trip_; }
 
-json_t const& trip_request::to_json() const
-{ return body_; }
+json_t trip_request::to_json() const
+{
+  json_t output = trip().to_json();
+  output.add_child("meta", meta().to_json());
+  output.add_child("location", location().to_json());
+  return output;
+}
 
 //
 // trip_response
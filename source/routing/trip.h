@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <span>
 #include <vector>
 #include <string>
 #include <chrono>
@@ -16,6 +17,7 @@
 #include "rpc/service.h"
 #include "model/address.h"
 #include "utils/datetime.h"
+#include "utils/json_encode.h"
 
 namespace sentio::routing
 {
@@ -96,6 +98,14 @@ namespace sentio::routing
     waypoints_container waypoints_;
   };
 
+  /**
+   * Decodes an unoptimized trip from a parsed request, 
+   * accepts the same fields as the json_t constructor.
+   */
+  unoptimized_trip tag_invoke(
+    boost::json::value_to_tag<unoptimized_trip>,
+    boost::json::value const& v);
+
   /**
    * This type represents a trip that has been optimized by OSRM based on an 
    * unoptimized trip. The order of waypoints in this case matters.
@@ -148,6 +158,25 @@ namespace sentio::routing
     legs_container legs_;
   };
 
+  /**
+   * Writes an optimized trip in the same shape as optimized_trip::to_json,
+   * this is the result of synchronous trip calls.
+   */
+  constexpr auto json_fields(optimized_trip const*)
+  {
+    return std::make_tuple(
+      json::field("starting_point", &optimized_trip::starting_waypoint),
+      json::field("final_point", &optimized_trip::final_waypoint),
+      json::field("waypoints", [](optimized_trip const& t) {
+        // all but the starting and final points
+        return std::span<const waypoint>(&t[1], t.size() - 2);
+      }),
+      json::field("legs", &optimized_trip::legs),
+      json::field("geometry", [](optimized_trip const& t) -> std::string const& {
+        return t.geometry().serialized();
+      }));
+  }
+
 /**
  * Describes administrative data about a given trip, such as the 
  * account that triggered it, the id it was assigned, its creation time, etc.
@@ -157,6 +186,11 @@ class trip_metadata
 public:
   trip_metadata();
   trip_metadata(json_t const& json);
+  trip_metadata(
+    std::string region,
+    std::string accountid,
+    date_time_t createdat,
+    std::optional<std::string> id = {});
 
 public:
   /**
@@ -238,9 +272,19 @@ class trip_request
 public:
   /**
    * Creates a trip object from a JSON representation of a trip.
+   * This is used when reading back trip requests queued on SQS.
    */
   trip_request(json_t b);
 
+  /**
+   * Creates a trip object from its already decoded parts,
+   * this is how trips submitted by clients are created.
+   */
+  trip_request(
+    unoptimized_trip trip,
+    trip_metadata metadata,
+    spacial::coordinates location);
+
 public:
   /**
    * A set of information that is added to a trip request by
@@ -265,10 +309,12 @@ public:
   unoptimized_trip const& trip() const;
 
 public:
-  json_t const& to_json() const;
+  json_t to_json() const;
+
+private:
+  void verify() const;
 
 private:
-  json_t body_;
   unoptimized_trip trip_;
   trip_metadata metadata_;
   spacial::coordinates location_;
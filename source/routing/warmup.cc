@@ -0,0 +1,237 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include <chrono>
+#include <random>
+#include <optional>
+#include <cstring>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <boost/geometry/geometries/box.hpp>
+#include <boost/geometry/algorithms/within.hpp>
+#include <boost/geometry/algorithms/envelope.hpp>
+
+#include "warmup.h"
+#include "osrm_interop.h"
+#include "spacial/index.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+
+namespace sentio::routing
+{
+
+namespace // detail
+{
+  /**
+   * A read-only shared mapping of a dataset file. Its pages are the
+   * page cache pages the engine maps, so whatever is done to them here
+   * applies to the engine as well.
+   */
+  class mapped_file
+  {
+  public:
+    explicit mapped_file(std::filesystem::path const& path)
+    {
+      int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(),
+          "failed to open " + path.string());
+      }
+
+      struct stat st;
+      if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        auto addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+          data_ = addr;
+          size_ = static_cast<size_t>(st.st_size);
+        }
+      }
+      ::close(fd);
+    }
+
+    ~mapped_file()
+    {
+      if (data_ != nullptr) {
+        ::munmap(data_, size_);
+      }
+    }
+
+  public: // noncopyable
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+  public:
+    void* data() const
+    { return data_; }
+
+    size_t size() const
+    { return size_; }
+
+  private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+  };
+
+  /**
+   * Brings all pages of a mapping into the page cache. The WILLNEED hint
+   * lets the kernel read the file in large sequential requests, reading
+   * one byte of every page afterwards blocks until they all arrived.
+   */
+  void prefetch(mapped_file const& file)
+  {
+    ::madvise(file.data(), file.size(), MADV_WILLNEED);
+
+    auto page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    auto bytes = static_cast<volatile const unsigned char*>(file.data());
+    unsigned char checksum = 0;
+    for (size_t offset = 0; offset < file.size(); offset += page) {
+      checksum ^= bytes[offset];
+    }
+    (void)checksum;
+  }
+
+  /**
+   * Dataset files kept mapped to hold their pages locked in memory.
+   */
+  struct pinned_dataset
+  {
+    std::vector<std::unique_ptr<mapped_file>> files;
+  };
+
+  /**
+   * Reads and optionally locks the pages of an mmap dataset.
+   */
+  std::shared_ptr<pinned_dataset> load_pages(
+    config const& config,
+    import::region_paths const& source)
+  {
+    auto pinned = std::make_shared<pinned_dataset>();
+    for (auto const& path: dataset_files(source.osrm)) {
+      auto file = std::make_unique<mapped_file>(path);
+      if (file->data() == nullptr) {
+        continue;
+      }
+
+      prefetch(*file);
+      if (!config.warmup.lock_pages) {
+        continue; // pages stay in the page cache after unmapping
+      }
+
+      if (::mlock(file->data(), file->size()) != 0) {
+        warnlog << "failed to lock " << path << " in memory: "
+                << std::strerror(errno);
+        continue;
+      }
+      pinned->files.push_back(std::move(file));
+    }
+    return pinned->files.empty() ? nullptr : pinned;
+  }
+
+  /**
+   * Runs routes between random points within the region, which touches
+   * the parts of the graph and the indices that the queries walk.
+   * Points off the road network are snapped by the engine, routes that
+   * fail anyway are only counted.
+   */
+  size_t run_routes(
+    osrm_instance const& engine,
+    size_t count,
+    import::region_paths const& source)
+  {
+    auto bounds = spacial::to_polygon(source.poly, source.name);
+    boost::geometry::model::box<spacial::coordinates> envelope;
+    boost::geometry::envelope(bounds, envelope);
+
+    std::minstd_rand rng(std::random_device{}());
+    std::uniform_real_distribution<double> latitude(
+      envelope.min_corner().latitude(), envelope.max_corner().latitude());
+    std::uniform_real_distribution<double> longitude(
+      envelope.min_corner().longitude(), envelope.max_corner().longitude());
+
+    auto random_point = [&]() -> std::optional<spacial::coordinates> {
+      for (int attempt = 0; attempt < 100; ++attempt) {
+        spacial::coordinates candidate(latitude(rng), longitude(rng));
+        if (boost::geometry::within(candidate, bounds)) {
+          return candidate;
+        }
+      }
+      return std::nullopt;
+    };
+
+    size_t failed = 0;
+    for (size_t i = 0; i < count; ++i) {
+      auto from = random_point();
+      auto to = random_point();
+      if (!from.has_value() || !to.has_value()) {
+        ++failed;
+        continue;
+      }
+
+      try {
+        engine.calculate_distance(*from, *to);
+      } catch (std::exception const&) {
+        ++failed;
+      }
+    }
+    return failed;
+  }
+}
+
+std::vector<std::filesystem::path> dataset_files(std::string const& basepath)
+{
+  namespace fs = std::filesystem;
+  fs::path base(basepath);
+  auto prefix = base.filename().string() + ".";
+  auto directory = base.has_parent_path()
+    ? base.parent_path() : fs::path(".");
+
+  std::vector<fs::path> output;
+  std::error_code ec;
+  for (auto const& file: fs::directory_iterator(directory, ec)) {
+    auto name = file.path().filename().string();
+    if (name.starts_with(prefix) && file.is_regular_file(ec)) {
+      output.push_back(file.path());
+    }
+  }
+  return output;
+}
+
+std::shared_ptr<void> warm_up(
+  osrm_instance const& engine,
+  config const& config,
+  import::region_paths const& source)
+{
+  auto& duration = metrics::registry::instance().add_histogram(
+    "osrm_engine_warmup_duration_seconds",
+    "Time spent warming up the OSRM engine of a region",
+    {{"region", source.name}});
+
+  auto started = std::chrono::steady_clock::now();
+  std::shared_ptr<pinned_dataset> pinned;
+
+  // datasets loaded into the heap are resident already, and shared
+  // memory regions are owned by osrm-datastore.
+  if (config.storage == config::storage_mode::mmap) {
+    pinned = load_pages(config, source);
+  }
+
+  auto failed = run_routes(engine, config.warmup.routes, source);
+  auto elapsed = std::chrono::steady_clock::now() - started;
+  duration.record(elapsed);
+
+  infolog << "warmed up routing engine for " << source.name << " in "
+          << std::chrono::duration_cast<
+               std::chrono::milliseconds>(elapsed).count() << "ms, "
+          << config.warmup.routes - failed << "/" << config.warmup.routes
+          << " synthetic routes succeeded"
+          << (pinned ? ", dataset locked in memory" : "");
+  return pinned;
+}
+
+}
@@ -0,0 +1,38 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <filesystem>
+
+#include "config.h"
+#include "import/map_source.h"
+
+namespace sentio::routing
+{
+
+class osrm_instance;
+
+/**
+ * The files of an OSRM dataset. For a base path like region.osrm
+ * those are the region.osrm.* files next to it.
+ */
+std::vector<std::filesystem::path> dataset_files(std::string const& basepath);
+
+/**
+ * Warms up a freshly loaded engine according to the warmup section of
+ * the routing config, before it serves its first query.
+ *
+ * Returns the dataset pages locked in memory, they stay locked for as
+ * long as the returned handle is alive and should be released together
+ * with the engine. Returns nullptr if nothing was locked.
+ */
+std::shared_ptr<void> warm_up(
+  osrm_instance const& engine,
+  config const& config,
+  import::region_paths const& source);
+
+}
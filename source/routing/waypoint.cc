@@ -29,6 +29,17 @@ waypoint::waypoint(json_t const& wp)
       to_std(wp.get_optional<std::string>("notes")))
 {}
 
+waypoint tag_invoke(
+  boost::json::value_to_tag<waypoint>, 
+  boost::json::value const& v)
+{
+  return waypoint(
+    boost::json::value_to<model::building>(json::at(v, "building")),
+    json::optional_string(v, "phone"),
+    json::optional_string(v, "input_method"),
+    json::optional_string(v, "notes"));
+}
+
 polyline::polyline(std::string serialized)
   : serialized_(std::move(serialized)) {}
 
@@ -6,6 +6,8 @@
 
 #include <string>
 #include <chrono>
+#include <vector>
+#include <cstdint>
 #include <optional>
 
 #include "model/address.h"
@@ -41,6 +43,25 @@ public:
   json_t to_json() const;
 };
 
+/**
+ * Decodes a waypoint from a parsed request.
+ */
+waypoint tag_invoke(
+  boost::json::value_to_tag<waypoint>, 
+  boost::json::value const& v);
+
+/**
+ * Writes a waypoint in the same shape as waypoint::to_json.
+ */
+constexpr auto json_fields(waypoint const*)
+{
+  return std::make_tuple(
+    json::field("building", &waypoint::building),
+    json::nonempty_field("phone", &waypoint::phone),
+    json::nonempty_field("notes", &waypoint::notes),
+    json::field("input_method", &waypoint::input_method));
+}
+
 /**
  * Represents the time and distance needed to travel between two waypoints.
  */
@@ -50,6 +71,19 @@ struct travel_cost
   std::chrono::seconds duration;
 };
 
+/**
+ * Travel costs from every source to every destination, stored row-major
+ * with one row per source. Pairs with no route between them are -1.
+ * Distances are left empty when only durations were requested.
+ */
+struct travel_matrix
+{
+  size_t rows;
+  size_t columns;
+  std::vector<int32_t> durations;  // seconds
+  std::vector<int32_t> distances;  // meters
+};
+
 /**
  * Represents a single leg of the route between two waypoints.
  */
@@ -62,6 +96,21 @@ struct route_leg
   json_t to_json() const;
 };
 
+constexpr auto json_fields(travel_cost const*)
+{
+  return std::make_tuple(
+    json::field("distance", &travel_cost::distance),
+    json::field("duration", &travel_cost::duration));
+}
+
+constexpr auto json_fields(route_leg const*)
+{
+  return std::make_tuple(
+    json::field("from_building", &route_leg::from_building),
+    json::field("to_building", &route_leg::to_building),
+    json::field("cost", &route_leg::cost));
+}
+
 /**
  * Represents a polyline that describes the driving directions
  * of a trip. This is used when rendering the map for the end-used.
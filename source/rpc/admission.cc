@@ -0,0 +1,272 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "admission.h"
+#include "error.h"
+#include "utils/log.h"
+#include "utils/metrics.h"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <boost/asio/post.hpp>
+
+namespace sentio::rpc
+{
+
+namespace net = boost::asio;
+
+namespace // detail
+{
+  size_t limit_of(
+    std::unordered_map<std::string, size_t> const& overrides,
+    std::string const& name, size_t fallback)
+  {
+    auto it = overrides.find(name);
+    return it != overrides.end() ? it->second : fallback;
+  }
+
+  /**
+   * A call fits if the budget is unlimited, idle or has enough units
+   * left. Admitting into an idle budget lets calls bigger than the
+   * whole budget through, one at a time.
+   */
+  bool within(size_t in_use, size_t cost, size_t limit)
+  {
+    return limit == 0 || in_use == 0 || in_use + cost <= limit;
+  }
+
+  /**
+   * Calls compete for the budget of their method and of their region,
+   * an empty region belongs to no budget.
+   */
+  bool competes(admission::ticket const& a, admission::ticket const& b)
+  {
+    return a.method == b.method || 
+      (!a.region.empty() && a.region == b.region);
+  }
+
+  size_t in_use_of(
+    std::unordered_map<std::string, size_t> const& in_use,
+    std::string const& name)
+  {
+    auto it = in_use.find(name);
+    return it != in_use.end() ? it->second : 0;
+  }
+
+  /**
+   * Budgets that nobody uses are dropped, so
+   * the maps only hold methods and regions in flight.
+   */
+  void give_back(
+    std::unordered_map<std::string, size_t>& in_use,
+    std::string const& name, size_t cost)
+  {
+    auto it = in_use.find(name);
+    if (it != in_use.end() && (it->second -= cost) == 0) {
+      in_use.erase(it);
+    }
+  }
+}
+
+admission::permit::permit(admission* owner, ticket t)
+  : owner_(owner)
+  , ticket_(std::move(t))
+{
+}
+
+admission::permit::permit(permit&& other) noexcept
+  : owner_(std::exchange(other.owner_, nullptr))
+  , ticket_(std::move(other.ticket_))
+{
+}
+
+admission::permit& admission::permit::operator=(permit&& other) noexcept
+{
+  if (this != &other) {
+    if (owner_ != nullptr) {
+      owner_->release(ticket_);
+    }
+    owner_ = std::exchange(other.owner_, nullptr);
+    ticket_ = std::move(other.ticket_);
+  }
+  return *this;
+}
+
+admission::permit::~permit()
+{
+  if (owner_ != nullptr) {
+    owner_->release(ticket_);
+  }
+}
+
+admission::admission(config const& config)
+  : config_(config)
+{
+  if (config_.admission.enabled) {
+    infolog << "admission control enabled, queue size: "
+            << config_.admission.queue_size << ", queue timeout: "
+            << config_.admission.queue_timeout.count() << "ms";
+  }
+
+  metrics::registry::instance().add_callback(
+    "rpc_admission_queued_calls", "Calls waiting for admission", {},
+    [this]() { return static_cast<double>(queued()); });
+}
+
+size_t admission::queued() const
+{
+  std::lock_guard lock(sync_);
+  return queue_.size();
+}
+
+void admission::admit(
+  ticket t,
+  net::any_io_executor completion,
+  handler_type handler)
+{
+  if (!config_.admission.enabled) {
+    handler(nullptr, permit());
+    return;
+  }
+
+  std::unique_lock lock(sync_);
+  if (fits(t) && !held_back(t)) {
+    acquire(t);
+    lock.unlock();
+    handler(nullptr, permit(this, std::move(t)));
+    return;
+  }
+
+  if (queue_.size() >= config_.admission.queue_size) {
+    lock.unlock();
+    dbglog << "admission queue full, rejecting " << t.method
+           << " call [cost: " << t.cost << "]";
+    reject(handler);
+    return;
+  }
+
+  auto w = std::make_shared<waiter>(
+    std::move(t), completion, std::move(handler));
+  queue_.push_back(w);
+  lock.unlock();
+
+  // the timer is only ever touched on the completion executor,
+  // which is where we are now.
+  w->timer.expires_after(config_.admission.queue_timeout);
+  w->timer.async_wait([this, w](boost::system::error_code ec) {
+    if (ec != net::error::operation_aborted) {
+      expire(w);
+    }
+  });
+}
+
+bool admission::held_back(ticket const& t) const
+{
+  for (auto const& w: queue_) {
+    if (!w->settled.load() && competes(w->request, t)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool admission::fits(ticket const& t)
+{
+  auto const& limits = config_.admission;
+  if (!within(in_use_of(methods_in_use_, t.method), t.cost,
+        limit_of(limits.methods, t.method, limits.method_limit))) {
+    return false;
+  }
+
+  if (!t.region.empty() &&
+      !within(in_use_of(regions_in_use_, t.region), t.cost,
+        limit_of(limits.regions, t.region, limits.region_limit))) {
+    return false;
+  }
+  return true;
+}
+
+void admission::acquire(ticket const& t)
+{
+  methods_in_use_[t.method] += t.cost;
+  if (!t.region.empty()) {
+    regions_in_use_[t.region] += t.cost;
+  }
+}
+
+void admission::release(ticket const& t)
+{
+  std::vector<std::shared_ptr<waiter>> admitted;
+
+  {
+    std::lock_guard lock(sync_);
+    give_back(methods_in_use_, t.method, t.cost);
+    if (!t.region.empty()) {
+      give_back(regions_in_use_, t.region, t.cost);
+    }
+
+    // admit every queued call that fits now, in arrival order. A call
+    // that doesn't fit holds back later calls to its method or region,
+    // so large calls aren't starved by smaller ones, but doesn't hold
+    // back calls to other methods and regions queued after it.
+    std::vector<ticket const*> waiting;
+    auto behind = [&waiting](ticket const& t) {
+      return std::any_of(waiting.begin(), waiting.end(),
+        [&t](ticket const* earlier) { return competes(*earlier, t); });
+    };
+
+    for (auto it = queue_.begin(); it != queue_.end();) {
+      auto& w = *it;
+      if (w->settled.load()) {
+        it = queue_.erase(it);  // expired
+      } else if (!behind(w->request) && fits(w->request)) {
+        if (!w->settled.exchange(true)) {
+          acquire(w->request);
+          admitted.push_back(w);
+        }
+        it = queue_.erase(it);
+      } else {
+        waiting.push_back(&w->request);
+        ++it;
+      }
+    }
+  }
+
+  for (auto& w: admitted) {
+    net::post(w->completion, [this, w]() {
+      w->timer.cancel();
+      auto handler = std::move(w->handler);
+      handler(nullptr, permit(this, std::move(w->request)));
+    });
+  }
+}
+
+void admission::expire(std::shared_ptr<waiter> w)
+{
+  if (w->settled.exchange(true)) {
+    return;  // admitted in the meantime
+  }
+
+  {
+    std::lock_guard lock(sync_);
+    queue_.remove(w);
+  }
+
+  dbglog << "admission deadline passed, rejecting "
+         << w->request.method << " call [cost: "
+         << w->request.cost << "]";
+  auto handler = std::move(w->handler);
+  reject(handler);
+}
+
+void admission::reject(handler_type const& handler) const
+{
+  handler(
+    std::make_exception_ptr(
+      overloaded(config_.admission.retry_after)),
+    permit());
+}
+
+}
@@ -0,0 +1,141 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <memory>
+#include <exception>
+#include <functional>
+#include <unordered_map>
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/any_io_executor.hpp>
+
+#include "server.h"
+
+namespace sentio::rpc
+{
+
+/**
+ * Decides whether a call may start executing now, has to wait for
+ * capacity or should be rejected because the server is overloaded.
+ *
+ * Capacity is tracked in cost units, per method and per region. Without
+ * it a burst of large trips would be accepted in full and every caller,
+ * including cheap geocoding calls, would see latency collapse. With it
+ * the excess is either queued for a short time or rejected right away,
+ * so the client can retry against another instance.
+ */
+class admission
+{
+public:
+  /**
+   * Describes what a call is about to consume.
+   */
+  struct ticket
+  {
+    std::string method;
+    std::string region;  // empty if the call is not bound to a region
+    size_t cost;
+  };
+
+  /**
+   * Proof of admission. The units of the ticket are held for as long
+   * as the permit lives and are released when it is destroyed.
+   */
+  class permit
+  {
+  public:
+    permit() = default;
+    permit(permit&& other) noexcept;
+    permit& operator=(permit&& other) noexcept;
+    ~permit();
+
+  public: // noncopyable
+    permit(permit const&) = delete;
+    permit& operator=(permit const&) = delete;
+
+  private:
+    friend class admission;
+    permit(admission* owner, ticket t);
+
+  private:
+    admission* owner_ = nullptr;
+    ticket ticket_;
+  };
+
+  /**
+   * Invoked with either a permit, or an overloaded exception
+   * when the call was rejected.
+   */
+  using handler_type = std::function<void(std::exception_ptr, permit)>;
+
+public:
+  admission(config const& config);
+
+public:
+  /**
+   * Requests capacity for a call. The handler is invoked inline when the
+   * call is admitted or rejected right away, otherwise it is invoked on
+   * the @c completion executor once capacity frees up or the queueing
+   * deadline passes. Must be called from the @c completion executor.
+   */
+  void admit(
+    ticket t,
+    boost::asio::any_io_executor completion,
+    handler_type handler);
+
+  /**
+   * Number of calls waiting for capacity.
+   */
+  size_t queued() const;
+
+public: // noncopyable
+  admission(admission const&) = delete;
+  admission& operator=(admission const&) = delete;
+
+private:
+  struct waiter
+  {
+    waiter(ticket t,
+      boost::asio::any_io_executor completion,
+      handler_type handler)
+      : request(std::move(t))
+      , completion(completion)
+      , handler(std::move(handler))
+      , timer(completion) {}
+
+    ticket request;
+    boost::asio::any_io_executor completion;
+    handler_type handler;
+    boost::asio::steady_timer timer;
+    std::atomic<bool> settled{false};  // admitted or expired
+  };
+
+private:
+  /**
+   * Whether an earlier call to the same method or region is still
+   * queued, new calls wait behind it even if they would fit.
+   */
+  bool held_back(ticket const& t) const;
+
+  bool fits(ticket const& t);
+  void acquire(ticket const& t);
+  void release(ticket const& t);
+  void expire(std::shared_ptr<waiter> w);
+  void reject(handler_type const& handler) const;
+
+private:
+  config const& config_;
+  mutable std::mutex sync_;
+  std::unordered_map<std::string, size_t> methods_in_use_;
+  std::unordered_map<std::string, size_t> regions_in_use_;
+  std::list<std::shared_ptr<waiter>> queue_;
+};
+
+}
@@ -4,13 +4,18 @@
 
 #include "auth.h"
 #include "utils/log.h"
+#include "utils/metrics.h"
 
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <future>
 #include <sstream>
-#include <cassert>
-#include <shared_mutex>
+#include <mutex>
+#include <thread>
+#include <cstdlib>
+#include <algorithm>
+#include <condition_variable>
 #include <unordered_map>
 
 #include <curl/curl.h>
@@ -45,7 +50,7 @@ public:
     std::string aud,
     std::string cert)
   {
-    return validator(kid, name, iss, aud, 
+    return validator(kid, name, iss, aud, cert,
       jwt::algorithm::rs256(cert));
   }
 
@@ -56,7 +61,7 @@ public:
     std::string aud,
     std::string key)
   {
-    return validator(kid, name, iss, aud, 
+    return validator(kid, name, iss, aud, key,
       jwt::algorithm::hs256(key));
   }
 
@@ -67,8 +72,9 @@ private:
     std::string name, 
     std::string iss, 
     std::string aud,
+    std::string key,
     Algorithm algo) 
-    : kid_(kid), iss_(iss), aud_(aud), name_(name)
+    : kid_(kid), iss_(iss), aud_(aud), name_(name), key_(std::move(key))
     , verifier_(jwt::verify()
         .with_issuer(std::move(iss))
         .with_audience(std::move(aud))
@@ -89,41 +95,113 @@ public:
   std::string audience() const
   { return aud_; }
 
+  /**
+   * Providers may rotate the key material under an existing kid,
+   * so validators are only the same if everything matches.
+   */
+  bool operator==(validator const& other) const
+  {
+    return kid_ == other.kid_ && name_ == other.name_ && 
+      iss_ == other.iss_ && aud_ == other.aud_ && key_ == other.key_;
+  }
+
 public:
   void verify(jwt::decoded_jwt<jwt::picojson_traits> const& token) const 
   { verifier_.verify(token); }
 
 private:
-  std::string kid_, iss_, aud_, name_;
+  std::string kid_, iss_, aud_, name_, key_;
   jwt::verifier<jwt::default_clock, jwt::picojson_traits> verifier_;
 };
 
-std::stringstream download_string(std::string url) 
+/**
+ * A downloaded document together with how long the server
+ * allows it to be cached, from its Cache-Control header.
+ */
+struct download
+{
+  std::stringstream body;
+  std::optional<std::chrono::seconds> max_age;
+  std::chrono::seconds age{0};  // time already spent in caches
+};
+
+void read_cache_header(std::string_view line, download& output)
+{
+  auto colon = line.find(':');
+  if (colon == std::string_view::npos) {
+    return;
+  }
+  auto name = line.substr(0, colon);
+  std::string value(line.substr(colon + 1));
+  boost::algorithm::to_lower(value);
+
+  if (boost::iequals(name, "cache-control")) {
+    static const std::string_view directive("max-age=");
+    if (auto at = value.find(directive); at != std::string::npos) {
+      output.max_age = std::chrono::seconds(std::strtol(
+        value.c_str() + at + directive.size(), nullptr, 10));
+    }
+  } else if (boost::iequals(name, "age")) {
+    output.age = std::chrono::seconds(std::strtol(value.c_str(), nullptr, 10));
+  }
+}
+
+download download_string(std::string url) 
 { 
   std::shared_ptr<CURL> curl(
     curl_easy_init(), 
     curl_easy_cleanup);
 
-  std::stringstream ss;
+  download output;
   curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &ss);
+  curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, 30L);
+  curl_easy_setopt(curl.get(), CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &output.body);
   curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, 
     +[](void *buffer, size_t, size_t nmemb, void *stream) {
       auto& s = *reinterpret_cast<std::stringstream*>(stream);
       s.write(static_cast<const char*>(buffer), nmemb);
       return nmemb;
     });
+  curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &output);
+  curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION,
+    +[](char *buffer, size_t, size_t nitems, void *target) {
+      read_cache_header(std::string_view(buffer, nitems),
+        *reinterpret_cast<download*>(target));
+      return nitems;
+    });
   
   if (auto res = curl_easy_perform(curl.get()); res != CURLE_OK) {
     errlog << "curl error while downloading auth keys: "
            << curl_easy_strerror(res);
     throw std::runtime_error(curl_easy_strerror(res));
-  } else {
-    return ss;
+  } 
+
+  long status = 0;
+  curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &status);
+  if (status != 200) {
+    errlog << "http status " << status << " while downloading auth keys";
+    throw std::runtime_error("unexpected http status");
   }
+
+  if (output.max_age.has_value()) {
+    output.max_age = std::max(std::chrono::seconds(0), 
+      *output.max_age - output.age);
+  }
+  return output;
 }
 
-std::vector<validator> read_validator(json_t const& entry) {
+/**
+ * Validators of one configured identity provider. Remote key sets
+ * also report how long they may be used before fetching them again.
+ */
+struct provider_keys
+{
+  std::vector<validator> validators;
+  std::optional<std::chrono::seconds> max_age;
+};
+
+provider_keys read_validator(json_t const& entry) {
   auto construct = validator::rs256;
 
   if (entry.get<std::string>("type") == "jwt+rs256") {
@@ -136,13 +214,14 @@ std::vector<validator> read_validator(json_t const& entry) {
     throw std::runtime_error("unsupported auth method");
   }
 
-  std::vector<validator> output;
+  provider_keys output;
   if (entry.get_child("keys").size() == 0) {
     json_t keys;
-    auto instream = download_string(entry.get<std::string>("keys"));
-    boost::property_tree::read_json(instream, keys);
+    auto downloaded = download_string(entry.get<std::string>("keys"));
+    boost::property_tree::read_json(downloaded.body, keys);
+    output.max_age = downloaded.max_age;
     for (auto const& key: keys) {
-      output.push_back(construct(
+      output.validators.push_back(construct(
         key.first, 
         entry.get<std::string>("name"),
         entry.get<std::string>("issuer"),
@@ -151,7 +230,7 @@ std::vector<validator> read_validator(json_t const& entry) {
     }
   } else {
     for (auto const& key: entry.get_child("keys")) {
-      output.push_back(construct(
+      output.validators.push_back(construct(
         key.first, 
         entry.get<std::string>("name"),
         entry.get<std::string>("issuer"),
@@ -162,35 +241,79 @@ std::vector<validator> read_validator(json_t const& entry) {
   return output;
 }
 
+/**
+ * Distinct tokens remembered after verification. Firebase tokens are
+ * valid for an hour, this comfortably covers every active user of an
+ * instance at ~100 bytes per entry.
+ */
+constexpr size_t token_cache_capacity = 64 * 1024;
+
+/**
+ * Remote keys are fetched again when their Cache-Control max-age runs
+ * out, within these bounds, or hourly if the server doesn't say. Failed
+ * fetches are retried with exponential backoff.
+ */
+constexpr std::chrono::seconds default_refresh_interval(3600);
+constexpr std::chrono::seconds min_refresh_interval(60);
+constexpr std::chrono::seconds max_refresh_interval(24 * 3600);
+constexpr std::chrono::seconds min_retry_delay(5);
+constexpr std::chrono::seconds max_retry_delay(300);
+
 class auth::impl 
 {
 public:
   impl(json_t const& cfg)
   : cfg_(cfg)
+  , keys_(std::make_shared<keyset const>())
+  , cache_(token_cache_capacity)
+  , hits_(metrics::registry::instance().add_counter(
+      "rpc_auth_cache_hits_total", "Access tokens found in the verified tokens cache"))
+  , misses_(metrics::registry::instance().add_counter(
+      "rpc_auth_cache_misses_total", "Access tokens that needed signature verification"))
   {
-    refresh_ = std::thread([this]() {
-      while (true) {
-        // Google refreshes their Firebase auth 
-        // tokens every 3600 seconds. Redownload
-        // remote keys and keep them in memory
-        refresh_auth_keys(cfg_);
-        std::this_thread::sleep_for(
-          std::chrono::seconds(3600));
-      }
-    });
+    metrics::registry::instance().add_callback(
+      "rpc_auth_cache_entries", "Verified tokens currently cached", {},
+      [this]() { return static_cast<double>(cache_.size()); });
+
+    refresh_ = std::thread([this]() { refresh_loop(); });
+  }
+
+  ~impl()
+  {
+    {
+      std::lock_guard lock(stop_mutex_);
+      stopping_ = true;
+    }
+    stop_signal_.notify_all();
+    if (refresh_.joinable()) {
+      refresh_.join();
+    }
   }
 
 public:
-  json_t authorize(std::string_view const& token) const
+  identity authorize(std::string_view const& token) const
   { 
-    std::shared_lock lock(mutex_);
+    // all checks of one token run against the same snapshot, a
+    // refresh publishing a new one doesn't wait for them to finish.
+    auto keys = current_keys();
+    if (auto cached = cache_.find(token, keys->generation); cached.has_value()) {
+      hits_.add();
+      return std::move(cached).value();
+    }
+    misses_.add();
+
     auto decoded = jwt::decode(std::string(token));
-    if (auto it = keys_.find(decoded.get_key_id()); it != keys_.end()) {
+    if (auto it = keys->validators.find(decoded.get_key_id()); 
+        it != keys->validators.end()) {
       it->second.verify(decoded);
 
-      json_t output;
-      output.add("upn", decoded.get_payload_claim("phone_number").as_string());
-      output.add("idp", it->second.name());
+      identity output {
+        .upn = decoded.get_payload_claim("phone_number").as_string(),
+        .idp = it->second.name()
+      };
+      if (decoded.has_expires_at()) {
+        cache_.insert(token, output, decoded.get_expires_at(), keys->generation);
+      }
       return output;
     } else {
       throw std::runtime_error("kid not trusted");
@@ -199,47 +322,132 @@ public:
 
 public:
   size_t size() const 
-  { 
-    std::shared_lock lock(mutex_);
-    return keys_.size(); 
-  }
+  { return current_keys()->validators.size(); }
 
   bool empty() const 
-  { 
-    std::shared_lock lock(mutex_);
-    return keys_.empty(); 
-  }
+  { return current_keys()->validators.empty(); }
 
 private:
-  void refresh_auth_keys(json_t const& cfg)
+  /**
+   * An immutable set of trusted keys. Readers take a reference to the
+   * current set and never lock, refreshes build a new set and publish
+   * it with a single atomic pointer swap. The generation changes with
+   * every published set and tags tokens cached by verifying with it.
+   */
+  struct keyset
+  {
+    std::unordered_map<std::string, validator> validators;
+    uint64_t generation = 0;
+  };
+
+  std::shared_ptr<keyset const> current_keys() const
+  { return std::atomic_load_explicit(&keys_, std::memory_order_acquire); }
+
+  void refresh_loop()
+  {
+    auto retry_delay = min_retry_delay;
+    while (true) {
+      auto next_refresh = refresh_auth_keys();
+      std::chrono::seconds delay;
+      if (next_refresh.has_value()) {
+        delay = std::clamp(*next_refresh, 
+          min_refresh_interval, max_refresh_interval);
+        retry_delay = min_retry_delay;
+      } else {
+        delay = retry_delay;
+        retry_delay = std::min(retry_delay * 2, max_retry_delay);
+        warnlog << "retrying auth keys refresh in " 
+                << delay.count() << " seconds";
+      }
+
+      std::unique_lock lock(stop_mutex_);
+      if (stop_signal_.wait_for(lock, delay, [this]() { return stopping_; })) {
+        return;
+      }
+    }
+  }
+
+  /**
+   * Downloads and imports all configured key sets without holding any
+   * lock. Returns when the keys should be fetched next, or nothing if
+   * any of the sets failed and the refresh should be retried soon.
+   */
+  std::optional<std::chrono::seconds> refresh_auth_keys()
   {
-    std::unique_lock lock(mutex_);
-    for (auto const& keyset: cfg) {
+    auto current = current_keys();
+    auto next = std::make_shared<keyset>();
+    std::chrono::seconds next_refresh = default_refresh_interval;
+    bool complete = true;
+
+    for (auto const& keyset: cfg_) {
       try {
-        for (auto const& v: read_validator(keyset.second)) {
-          if (keys_.find(v.kid()) == keys_.end()) {
-            keys_.emplace(v.kid(), v);
-          }
+        auto imported = read_validator(keyset.second);
+        for (auto const& v: imported.validators) {
+          next->validators.emplace(v.kid(), v);
+        }
+        if (imported.max_age.has_value()) {
+          next_refresh = std::min(next_refresh, *imported.max_age);
         }
       } catch(const std::exception& e) {
+        complete = false;
         warnlog << "failed to import auth jwk: " << e.what() 
                 << ". key def: " << to_string(keyset.second);
+
+        // keep trusting what was imported for this provider 
+        // before, until a fetch succeeds again.
+        auto name = keyset.second.get<std::string>("name", "");
+        for (auto const& [kid, v]: current->validators) {
+          if (v.name() == name) {
+            next->validators.emplace(kid, v);
+          }
+        }
       }
     }
 
-    assert(!keys_.empty());
-    for (auto const& kv: keys_) {
-      infolog << "activated authentication key " << kv.first
-              << " with issuer " << kv.second.issuer() 
-              << " with audience " << kv.second.audience();
+    bool changed = next->validators.size() != current->validators.size();
+    for (auto const& kv: next->validators) {
+      auto it = current->validators.find(kv.first);
+      changed = changed || 
+        it == current->validators.end() || it->second != kv.second;
     }
+
+    if (changed) {
+      // drops all verified tokens from the cache
+      next->generation = current->generation + 1;
+      std::atomic_store_explicit(&keys_, 
+        std::shared_ptr<keyset const>(std::move(next)),
+        std::memory_order_release);
+
+      for (auto const& kv: current_keys()->validators) {
+        infolog << "activated authentication key " << kv.first
+                << " with issuer " << kv.second.issuer() 
+                << " with audience " << kv.second.audience();
+      }
+    }
+
+    if (current_keys()->validators.empty()) {
+      errlog << "no trusted authentication keys";
+      complete = false;
+    }
+
+    if (!complete) {
+      return std::nullopt;
+    }
+    return next_refresh;
   }
 
 private:
   json_t const& cfg_;
+  std::shared_ptr<keyset const> keys_;
+
   std::thread refresh_;
-  mutable std::shared_mutex mutex_;
-  std::unordered_map<std::string, validator> keys_;
+  std::mutex stop_mutex_;
+  std::condition_variable stop_signal_;
+  bool stopping_ = false;
+
+  mutable token_cache cache_;
+  metrics::counter& hits_;
+  metrics::counter& misses_;
 };
 
 
@@ -259,13 +467,13 @@ size_t auth::size() const
 bool auth::empty() const 
 { return impl_->empty(); }
 
-std::optional<json_t> auth::authorize(std::string_view const& token) const
+std::optional<identity> auth::authorize(std::string_view const& token) const
 { 
   try {
     return impl_->authorize(token);
   } catch (std::exception const& e) {
     warnlog << "auth failed for token " << token << " because " << e.what();
-    return std::optional<json_t>();
+    return std::nullopt;
   }
 }
 
@@ -9,6 +9,7 @@
 #include <string_view>
 
 #include "utils/json.h"
+#include "token_cache.h"
 
 namespace sentio::rpc
 {
@@ -29,7 +30,12 @@ public:
   size_t size() const;
 
 public:
-  std::optional<json_t> authorize(std::string_view const&) const;
+  /**
+   * Verifies a bearer token and returns who it belongs to, or nothing
+   * if it is not trusted. Tokens verified before are answered from a
+   * cache until they expire or the trusted keys change.
+   */
+  std::optional<identity> authorize(std::string_view const&) const;
 
 private:
   class impl;
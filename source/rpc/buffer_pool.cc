@@ -0,0 +1,112 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "buffer_pool.h"
+#include "utils/metrics.h"
+
+#include <bit>
+#include <new>
+#include <algorithm>
+
+namespace sentio::rpc
+{
+
+namespace // detail
+{
+  /**
+   * Number of bits of the smallest size class that fits n bytes.
+   */
+  size_t class_bits(size_t n)
+  {
+    size_t bits = n <= 1 ? 0 : std::bit_width(n - 1);
+    return std::max(bits, buffer_pool::min_class_bits);
+  }
+}
+
+buffer_pool& buffer_pool::instance()
+{
+  // keep up to 256 free blocks of the smallest size class
+  static buffer_pool pool(256);
+  return pool;
+}
+
+buffer_pool::buffer_pool(size_t max_cached)
+  : max_cached_(max_cached)
+{
+  // deallocate() must not allocate
+  for (auto& sc: classes_) {
+    sc.blocks.reserve(max_cached_);
+  }
+
+  auto& registry = metrics::registry::instance();
+  registry.add_callback("rpc_buffer_pool_bytes", 
+    "Memory of the session buffer pool", {{"state", "in_use"}},
+    [this]() { return static_cast<double>(usage().in_use_bytes); });
+  registry.add_callback("rpc_buffer_pool_bytes", "", {{"state", "cached"}},
+    [this]() { return static_cast<double>(usage().cached_bytes); });
+}
+
+void* buffer_pool::allocate(size_t n)
+{
+  size_t bits = class_bits(n);
+  if (bits > max_class_bits) {
+    in_use_bytes_ += n;
+    return ::operator new(n);
+  }
+
+  size_t blocksize = size_t(1) << bits;
+  in_use_bytes_ += blocksize;
+
+  auto& sc = classes_[bits - min_class_bits];
+  {
+    std::lock_guard lock(sc.sync);
+    if (!sc.blocks.empty()) {
+      void* block = sc.blocks.back();
+      sc.blocks.pop_back();
+      cached_bytes_ -= blocksize;
+      return block;
+    }
+  }
+  return ::operator new(blocksize);
+}
+
+void buffer_pool::deallocate(void* p, size_t n) noexcept
+{
+  size_t bits = class_bits(n);
+  if (bits > max_class_bits) {
+    in_use_bytes_ -= n;
+    ::operator delete(p);
+    return;
+  }
+
+  size_t blocksize = size_t(1) << bits;
+  in_use_bytes_ -= blocksize;
+
+  // bigger blocks are cached in fewer numbers, so the total
+  // cached memory stays at about max_cached_ smallest blocks
+  // per size class.
+  size_t limit = std::max<size_t>(2, 
+    max_cached_ >> (bits - min_class_bits));
+
+  auto& sc = classes_[bits - min_class_bits];
+  {
+    std::lock_guard lock(sc.sync);
+    if (sc.blocks.size() < limit) {
+      sc.blocks.push_back(p);
+      cached_bytes_ += blocksize;
+      return;
+    }
+  }
+  ::operator delete(p);
+}
+
+buffer_pool::stats buffer_pool::usage() const
+{
+  return stats {
+    .in_use_bytes = in_use_bytes_.load(std::memory_order_relaxed),
+    .cached_bytes = cached_bytes_.load(std::memory_order_relaxed)
+  };
+}
+
+}
@@ -0,0 +1,104 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace sentio::rpc
+{
+
+/**
+ * A process-wide pool of memory blocks backing session I/O buffers.
+ *
+ * Sessions start with empty buffers that grow on demand while a message
+ * is being read, and give their memory back as soon as they become idle.
+ * Blocks are rounded up to power-of-two size classes and recycled between
+ * sessions, so the steady state does not hit the system allocator while
+ * an idle connection holds no buffer memory at all.
+ */
+class buffer_pool
+{
+public:
+  static constexpr size_t min_class_bits = 9;  // 512B
+  static constexpr size_t max_class_bits = 20; // 1MB
+  static constexpr size_t class_count = max_class_bits - min_class_bits + 1;
+
+  struct stats {
+    size_t in_use_bytes;  // held by sessions
+    size_t cached_bytes;  // free blocks kept for reuse
+  };
+
+public:
+  static buffer_pool& instance();
+
+public:
+  /**
+   * Returns a block of at least n bytes. Blocks larger than the biggest
+   * size class bypass the pool and come straight from the allocator.
+   */
+  void* allocate(size_t n);
+
+  /**
+   * Returns a block obtained from allocate(n) to the pool.
+   */
+  void deallocate(void* p, size_t n) noexcept;
+
+  stats usage() const;
+
+private:
+  buffer_pool(size_t max_cached);
+
+private:
+  struct size_class {
+    std::mutex sync;
+    std::vector<void*> blocks;
+  };
+
+  size_t const max_cached_;
+  std::array<size_class, class_count> classes_;
+  std::atomic<size_t> in_use_bytes_{0};
+  std::atomic<size_t> cached_bytes_{0};
+};
+
+/**
+ * Standard allocator interface over the buffer pool,
+ * used to back beast dynamic buffers in sessions.
+ */
+template <typename T>
+class pooled_allocator
+{
+public:
+  using value_type = T;
+
+  pooled_allocator() noexcept = default;
+
+  template <typename U>
+  pooled_allocator(pooled_allocator<U> const&) noexcept {}
+
+public:
+  T* allocate(size_t n)
+  {
+    return static_cast<T*>(
+      buffer_pool::instance().allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t n) noexcept
+  { buffer_pool::instance().deallocate(p, n * sizeof(T)); }
+
+public:
+  template <typename U>
+  bool operator==(pooled_allocator<U> const&) const noexcept
+  { return true; }
+
+  template <typename U>
+  bool operator!=(pooled_allocator<U> const&) const noexcept
+  { return false; }
+};
+
+}
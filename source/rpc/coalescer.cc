@@ -0,0 +1,145 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "coalescer.h"
+
+#include <string>
+#include <algorithm>
+#include <openssl/sha.h>
+#include <boost/asio/post.hpp>
+#include <boost/json/serialize.hpp>
+
+namespace sentio::rpc
+{
+
+namespace // detail
+{
+  /**
+   * Appends a representation of a JSON value that doesn't depend on the 
+   * order of object members. Strings and keys are length-prefixed, so 
+   * no escaping is needed to keep the encoding unambiguous.
+   */
+  void canonicalize(boost::json::value const& value, std::string& out)
+  {
+    auto append_string = [&out](std::string_view s) {
+      out.append(std::to_string(s.size())).append(1, ':').append(s);
+    };
+
+    switch (value.kind()) {
+      case boost::json::kind::object: {
+        auto const& obj = value.get_object();
+        std::vector<boost::json::key_value_pair const*> members;
+        members.reserve(obj.size());
+        for (auto const& kv: obj) {
+          members.push_back(&kv);
+        }
+        std::sort(members.begin(), members.end(), 
+          [](auto const* a, auto const* b) { return a->key() < b->key(); });
+
+        out.append(1, '{');
+        for (auto const* kv: members) {
+          append_string(kv->key());
+          canonicalize(kv->value(), out);
+        }
+        out.append(1, '}');
+        break;
+      }
+      case boost::json::kind::array:
+        out.append(1, '[');
+        for (auto const& item: value.get_array()) {
+          canonicalize(item, out);
+        }
+        out.append(1, ']');
+        break;
+      case boost::json::kind::string:
+        out.append(1, 's');
+        append_string(value.get_string());
+        break;
+      default: // numbers, booleans and null
+        out.append(1, 'v').append(boost::json::serialize(value)).append(1, ';');
+        break;
+    }
+  }
+}
+
+coalescer::coalescer()
+  : hits_(metrics::registry::instance().add_counter(
+      "rpc_coalescing_hits_total", 
+      "Calls that shared the outcome of an identical call in flight"))
+  , misses_(metrics::registry::instance().add_counter(
+      "rpc_coalescing_misses_total",
+      "Coalescable calls that had to be executed"))
+{
+}
+
+coalescer::digest coalescer::key_of(
+  std::string_view method,
+  context const& ctx,
+  params_t const& params)
+{
+  std::string canonical;
+  canonical.append(method).append(1, '\n')
+           .append(ctx.idp).append(1, '\n')
+           .append(ctx.uid).append(1, '\n');
+  canonicalize(params, canonical);
+
+  digest output;
+  SHA256(reinterpret_cast<const unsigned char*>(canonical.data()),
+    canonical.size(), output.data());
+  return output;
+}
+
+// the table hashes the leading bytes of the digest, shards
+// are picked by a different byte so they are independent.
+coalescer::shard& coalescer::shard_of(digest const& key)
+{ return shards_[key[31] % shard_count]; }
+
+bool coalescer::join(
+  digest const& key, 
+  boost::asio::any_io_executor ex, 
+  handler h)
+{
+  auto& s = shard_of(key);
+  std::lock_guard lock(s.mutex);
+  auto [it, inserted] = s.flights.try_emplace(key);
+  it->second.push_back(waiter { 
+    .executor = std::move(ex), 
+    .callback = std::move(h) 
+  });
+
+  if (inserted) {
+    misses_.add();
+  } else {
+    hits_.add();
+  }
+  return inserted;
+}
+
+void coalescer::complete(
+  digest const& key, 
+  std::exception_ptr error, 
+  result_t result)
+{
+  std::vector<waiter> waiters;
+  {
+    auto& s = shard_of(key);
+    std::lock_guard lock(s.mutex);
+    auto it = s.flights.find(key);
+    if (it == s.flights.end()) {
+      return;
+    }
+    waiters = std::move(it->second);
+    s.flights.erase(it);
+  }
+
+  // results share their value, copies are cheap
+  for (auto& w: waiters) {
+    boost::asio::post(w.executor, 
+      [callback = std::move(w.callback), error, result]() mutable {
+        callback(error, std::move(result));
+      });
+  }
+}
+
+}
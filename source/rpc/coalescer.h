@@ -0,0 +1,102 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <vector>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <boost/asio/any_io_executor.hpp>
+
+#include "service.h"
+#include "utils/metrics.h"
+
+namespace sentio::rpc
+{
+
+/**
+ * Collapses identical calls that are in flight at the same time into one
+ * execution whose outcome is shared by all callers. Dispatchers hitting
+ * refresh send the same trip several times within a second, without this
+ * every copy would repeat the whole OSRM computation.
+ *
+ * Calls are identical when they invoke the same method on behalf of the
+ * same account with the same parameters, compared by the SHA-256 of their
+ * canonical form, in which object members are sorted by name. Only calls
+ * still executing are shared, nothing is cached after they complete.
+ */
+class coalescer
+{
+public:
+  using digest = std::array<unsigned char, 32>;
+  using handler = std::function<void(std::exception_ptr, result_t)>;
+  static constexpr size_t shard_count = 16;
+
+public:
+  coalescer();
+
+public: // noncopyable
+  coalescer(coalescer const&) = delete;
+  coalescer& operator=(coalescer const&) = delete;
+
+public:
+  /**
+   * Identifies calls of @c method made by the caller with @c params.
+   */
+  static digest key_of(
+    std::string_view method,
+    context const& ctx,
+    params_t const& params);
+
+  /**
+   * Registers @c h to be invoked on @c ex with the outcome of the call
+   * identified by @c key. Returns true if no such call was in flight, in
+   * which case the caller must execute it and report its outcome with 
+   * complete, otherwise the call is already taken care of.
+   */
+  bool join(digest const& key, boost::asio::any_io_executor ex, handler h);
+
+  /**
+   * Ends the call identified by @c key and posts its outcome to the 
+   * executors of all handlers that joined it.
+   */
+  void complete(digest const& key, std::exception_ptr error, result_t result);
+
+private:
+  struct digest_hash
+  {
+    size_t operator()(digest const& d) const
+    {
+      size_t h;
+      std::memcpy(&h, d.data(), sizeof(h));
+      return h;
+    }
+  };
+
+  struct waiter
+  {
+    boost::asio::any_io_executor executor;
+    handler callback;
+  };
+
+  struct alignas(64) shard
+  {
+    std::mutex mutex;
+    std::unordered_map<digest, std::vector<waiter>, digest_hash> flights;
+  };
+
+  shard& shard_of(digest const& key);
+
+private:
+  std::array<shard, shard_count> shards_;
+  metrics::counter& hits_;
+  metrics::counter& misses_;
+};
+
+}
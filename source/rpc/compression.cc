@@ -0,0 +1,373 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "compression.h"
+#include "utils/metrics.h"
+
+#include <array>
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <zlib.h>
+#if defined(WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+#include <boost/algorithm/string.hpp>
+
+namespace sentio::rpc::compression
+{
+
+namespace // detail
+{
+  /**
+   * Compressed output is produced into this many bytes
+   * at a time before being handed to the sink.
+   */
+  constexpr size_t chunk_size = 16 * 1024;
+
+  /**
+   * One zlib stream, the window bits select the container:
+   * 15 + 16 writes a gzip header and trailer, 15 a zlib one,
+   * which is what "deflate" means in HTTP.
+   */
+  class zlib_stream
+  {
+  public:
+    explicit zlib_stream(int window_bits)
+      : window_bits_(window_bits) {}
+
+    ~zlib_stream()
+    {
+      if (initialized_) {
+        deflateEnd(&stream_);
+      }
+    }
+
+  public: // noncopyable
+    zlib_stream(zlib_stream const&) = delete;
+    zlib_stream& operator=(zlib_stream const&) = delete;
+
+  public:
+    void reset(int level)
+    {
+      if (initialized_ && level == level_) {
+        deflateReset(&stream_);
+        return;
+      }
+
+      if (initialized_) {
+        deflateEnd(&stream_);
+        initialized_ = false;
+      }
+
+      stream_ = z_stream{};
+      if (deflateInit2(&stream_, level, Z_DEFLATED,
+            window_bits_, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("failed to initialize zlib stream");
+      }
+      initialized_ = true;
+      level_ = level;
+    }
+
+    void update(boost::asio::const_buffer input, int flush,
+                char* chunk, detail::sink output)
+    {
+      stream_.next_in = static_cast<Bytef*>(const_cast<void*>(input.data()));
+      stream_.avail_in = static_cast<uInt>(input.size());
+
+      int status = Z_OK;
+      do {
+        stream_.next_out = reinterpret_cast<Bytef*>(chunk);
+        stream_.avail_out = chunk_size;
+        status = deflate(&stream_, flush);
+        if (status == Z_STREAM_ERROR) {
+          throw std::runtime_error("zlib stream error");
+        }
+        size_t produced = chunk_size - stream_.avail_out;
+        if (produced != 0) {
+          output.write(output.target, chunk, produced);
+        }
+      } while (stream_.avail_out == 0 ||
+              (flush == Z_FINISH && status != Z_STREAM_END));
+    }
+
+  private:
+    int window_bits_;
+    int level_ = 0;
+    bool initialized_ = false;
+    z_stream stream_{};
+  };
+
+#if defined(WITH_ZSTD)
+  class zstd_stream
+  {
+  public:
+    zstd_stream()
+      : context_(ZSTD_createCCtx())
+    {
+      if (context_ == nullptr) {
+        throw std::bad_alloc();
+      }
+    }
+
+    ~zstd_stream()
+    { ZSTD_freeCCtx(context_); }
+
+  public: // noncopyable
+    zstd_stream(zstd_stream const&) = delete;
+    zstd_stream& operator=(zstd_stream const&) = delete;
+
+  public:
+    void reset(int level)
+    {
+      ZSTD_CCtx_reset(context_, ZSTD_reset_session_only);
+      ZSTD_CCtx_setParameter(context_, ZSTD_c_compressionLevel, level);
+    }
+
+    void update(boost::asio::const_buffer input, ZSTD_EndDirective mode,
+                char* chunk, detail::sink output)
+    {
+      ZSTD_inBuffer in{input.data(), input.size(), 0};
+      bool done = false;
+      do {
+        ZSTD_outBuffer out{chunk, chunk_size, 0};
+        size_t remaining = ZSTD_compressStream2(context_, &out, &in, mode);
+        if (ZSTD_isError(remaining)) {
+          throw std::runtime_error(ZSTD_getErrorName(remaining));
+        }
+        if (out.pos != 0) {
+          output.write(output.target, chunk, out.pos);
+        }
+        done = mode == ZSTD_e_end ? remaining == 0 : in.pos == in.size;
+      } while (!done);
+    }
+
+  private:
+    ZSTD_CCtx* context_;
+  };
+#endif
+
+  /**
+   * Compressors of one network thread, created on first use and
+   * kept until the thread exits.
+   */
+  struct thread_state
+  {
+    encoding active = encoding::identity;
+    zlib_stream gzip{MAX_WBITS + 16};
+    zlib_stream deflate{MAX_WBITS};
+#if defined(WITH_ZSTD)
+    zstd_stream zstd;
+#endif
+    std::array<char, chunk_size> chunk;
+  };
+
+  thread_state& local_state()
+  {
+    thread_local thread_state state;
+    return state;
+  }
+
+  /**
+   * Series of one encoding, registered once for the process.
+   */
+  struct encoding_metrics
+  {
+    explicit encoding_metrics(encoding e)
+      : duration(metrics::registry::instance().add_histogram(
+          "rpc_compression_duration_seconds",
+          "CPU time spent compressing HTTP responses",
+          {{"encoding", std::string(name_of(e))}}))
+      , input(metrics::registry::instance().add_counter(
+          "rpc_compression_input_bytes_total",
+          "Bytes of HTTP responses before compression",
+          {{"encoding", std::string(name_of(e))}}))
+      , output(metrics::registry::instance().add_counter(
+          "rpc_compression_output_bytes_total",
+          "Bytes of HTTP responses after compression",
+          {{"encoding", std::string(name_of(e))}}))
+      , saved(metrics::registry::instance().add_counter(
+          "rpc_compression_saved_bytes_total",
+          "Bytes not sent to clients thanks to compression",
+          {{"encoding", std::string(name_of(e))}}))
+    {}
+
+    metrics::histogram& duration;
+    metrics::counter& input;
+    metrics::counter& output;
+    metrics::counter& saved;
+  };
+
+  encoding_metrics& metrics_of(encoding e)
+  {
+    static std::array<encoding_metrics, 3> all {
+      encoding_metrics(encoding::gzip),
+      encoding_metrics(encoding::deflate),
+      encoding_metrics(encoding::zstd)
+    };
+    return all[static_cast<size_t>(e) - 1];
+  }
+
+  bool available(encoding e)
+  {
+#if defined(WITH_ZSTD)
+    return e != encoding::identity;
+#else
+    return e == encoding::gzip || e == encoding::deflate;
+#endif
+  }
+
+  std::string_view trim(std::string_view text)
+  {
+    auto first = text.find_first_not_of(" \t");
+    if (first == std::string_view::npos) {
+      return {};
+    }
+    auto last = text.find_last_not_of(" \t");
+    return text.substr(first, last - first + 1);
+  }
+
+  /**
+   * Quality of a single Accept-Encoding element, "q=0.5" style
+   * parameters, anything unparsable counts as not acceptable.
+   */
+  double quality_of(std::string_view params)
+  {
+    std::vector<std::string_view> parts;
+    boost::split(parts, params, boost::is_any_of(";"));
+    for (auto part: parts) {
+      part = trim(part);
+      if (part.size() > 2 && (part[0] == 'q' || part[0] == 'Q') && part[1] == '=') {
+        std::string value(part.substr(2));
+        char* end = nullptr;
+        double q = std::strtod(value.c_str(), &end);
+        return end == value.c_str() + value.size() ? q : 0.0;
+      }
+    }
+    return 1.0;
+  }
+}
+
+std::string_view name_of(encoding e)
+{
+  switch (e) {
+    case encoding::gzip: return "gzip";
+    case encoding::deflate: return "deflate";
+    case encoding::zstd: return "zstd";
+    default: return "identity";
+  }
+}
+
+encoding negotiate(std::string_view accept_encoding)
+{
+  // in order of server preference
+  constexpr std::array<encoding, 3> candidates {
+    encoding::zstd, encoding::gzip, encoding::deflate };
+
+  std::array<double, 3> quality{-1, -1, -1};  // -1: not listed
+  double wildcard = -1;
+
+  std::vector<std::string_view> elements;
+  boost::split(elements, accept_encoding, boost::is_any_of(","));
+  for (auto element: elements) {
+    auto separator = element.find(';');
+    auto token = trim(element.substr(0, separator));
+    double q = separator == std::string_view::npos
+      ? 1.0 : quality_of(element.substr(separator + 1));
+
+    if (token == "*") {
+      wildcard = q;
+      continue;
+    }
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      if (boost::iequals(token, name_of(candidates[i]))) {
+        quality[i] = q;
+      }
+    }
+  }
+
+  encoding chosen = encoding::identity;
+  double best = 0;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    double q = quality[i] < 0 ? wildcard : quality[i];
+    if (available(candidates[i]) && q > best) {
+      best = q;
+      chosen = candidates[i];
+    }
+  }
+  return chosen;
+}
+
+namespace detail
+{
+  void begin(encoding e, int level)
+  {
+    auto& state = local_state();
+    switch (e) {
+      case encoding::gzip: state.gzip.reset(level); break;
+      case encoding::deflate: state.deflate.reset(level); break;
+#if defined(WITH_ZSTD)
+      case encoding::zstd: state.zstd.reset(level); break;
+#endif
+      default: throw std::invalid_argument("unsupported content encoding");
+    }
+    state.active = e;
+  }
+
+  void update(boost::asio::const_buffer input, sink output)
+  {
+    auto& state = local_state();
+    switch (state.active) {
+      case encoding::gzip:
+        state.gzip.update(input, Z_NO_FLUSH, state.chunk.data(), output);
+        break;
+      case encoding::deflate:
+        state.deflate.update(input, Z_NO_FLUSH, state.chunk.data(), output);
+        break;
+#if defined(WITH_ZSTD)
+      case encoding::zstd:
+        state.zstd.update(input, ZSTD_e_continue, state.chunk.data(), output);
+        break;
+#endif
+      default: break;
+    }
+  }
+
+  void finish(sink output)
+  {
+    auto& state = local_state();
+    boost::asio::const_buffer none;
+    switch (state.active) {
+      case encoding::gzip:
+        state.gzip.update(none, Z_FINISH, state.chunk.data(), output);
+        break;
+      case encoding::deflate:
+        state.deflate.update(none, Z_FINISH, state.chunk.data(), output);
+        break;
+#if defined(WITH_ZSTD)
+      case encoding::zstd:
+        state.zstd.update(none, ZSTD_e_end, state.chunk.data(), output);
+        break;
+#endif
+      default: break;
+    }
+    state.active = encoding::identity;
+  }
+
+  void record(encoding e, size_t input, size_t output,
+              std::chrono::steady_clock::duration elapsed)
+  {
+    auto& series = metrics_of(e);
+    series.duration.record(elapsed);
+    series.input.add(input);
+    series.output.add(output);
+    if (output < input) {
+      series.saved.add(input - output);
+    }
+  }
+}
+
+}
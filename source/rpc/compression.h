@@ -0,0 +1,104 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+
+#include <boost/asio/buffer.hpp>
+
+/**
+ * Content-Encoding of HTTP responses.
+ *
+ * Compressor state is expensive to set up, zlib allocates ~256KB per
+ * stream at the default memory level and zstd contexts are larger still.
+ * Every network thread keeps one compressor per encoding for its whole
+ * lifetime and resets it between responses, so compressing a response
+ * never allocates once a thread has warmed up.
+ */
+namespace sentio::rpc::compression
+{
+
+enum class encoding { identity, gzip, deflate, zstd };
+
+/**
+ * The token used for the encoding in Accept-Encoding
+ * and Content-Encoding headers.
+ */
+std::string_view name_of(encoding e);
+
+/**
+ * Picks the encoding for a response from the value of the client's
+ * Accept-Encoding header (RFC 9110, 12.5.3). Encodings with the highest
+ * quality win, ties are broken by preferring zstd over gzip over deflate.
+ * zstd is only offered when the server was built with libzstd. Returns
+ * identity when the client accepts none of them.
+ */
+encoding negotiate(std::string_view accept_encoding);
+
+namespace detail
+{
+  /**
+   * Receives compressed output of a stream.
+   */
+  struct sink
+  {
+    void* target;
+    void (*write)(void* target, const char* data, size_t size);
+  };
+
+  /**
+   * Resets the compressor of the calling thread for the given encoding,
+   * subsequent calls to update() and finish() on this thread feed it.
+   */
+  void begin(encoding e, int level);
+  void update(boost::asio::const_buffer input, sink output);
+  void finish(sink output);
+
+  /**
+   * Records the cost and effect of compressing one response.
+   */
+  void record(encoding e, size_t input, size_t output,
+              std::chrono::steady_clock::duration elapsed);
+
+  template <typename DynamicBuffer>
+  void write_into(void* target, const char* data, size_t size)
+  {
+    auto& buffer = *static_cast<DynamicBuffer*>(target);
+    buffer.commit(boost::asio::buffer_copy(
+      buffer.prepare(size), boost::asio::buffer(data, size)));
+  }
+}
+
+/**
+ * Compresses a buffer sequence into a dynamic buffer using the
+ * calling thread's compressor for the encoding and returns the
+ * number of compressed bytes appended to the output.
+ */
+template <typename ConstBufferSequence, typename DynamicBuffer>
+size_t compress(
+  encoding e, int level,
+  ConstBufferSequence const& input,
+  DynamicBuffer& output)
+{
+  auto started = std::chrono::steady_clock::now();
+  detail::sink sink{&output, &detail::write_into<DynamicBuffer>};
+  size_t before = output.size();
+
+  detail::begin(e, level);
+  for (auto it = boost::asio::buffer_sequence_begin(input);
+       it != boost::asio::buffer_sequence_end(input); ++it) {
+    detail::update(boost::asio::const_buffer(*it), sink);
+  }
+  detail::finish(sink);
+
+  size_t written = output.size() - before;
+  detail::record(e, boost::asio::buffer_size(input), written,
+    std::chrono::steady_clock::now() - started);
+  return written;
+}
+
+}
@@ -51,4 +51,30 @@ not_implemented::not_implemented(const char *msg)
 {
 }
 
+overloaded::overloaded(std::chrono::seconds retry_after)
+    : overloaded("server overloaded", retry_after)
+{
+}
+overloaded::overloaded(const char *msg, std::chrono::seconds retry_after)
+    : runtime_error(msg)
+    , retry_after_(retry_after)
+{
+}
+
+std::chrono::seconds overloaded::retry_after() const
+{
+  return retry_after_;
+}
+
+throttled::throttled(std::chrono::seconds retry_after)
+    : runtime_error("rate limit exceeded")
+    , retry_after_(retry_after)
+{
+}
+
+std::chrono::seconds throttled::retry_after() const
+{
+  return retry_after_;
+}
+
 }  // namespace sentio::kurier
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <stdexcept>
 
 namespace sentio::rpc
@@ -63,4 +64,39 @@ public:
   not_implemented(const char* msg);
 };
 
+/**
+ * Thrown when a call is rejected by admission control because the
+ * server is at capacity. Gets translated to HTTP 503 Service Unavailable
+ * with a Retry-After header, or the equivalent JSON-RPC error.
+ */
+class overloaded : public std::runtime_error
+{
+public:
+  overloaded(std::chrono::seconds retry_after);
+  overloaded(const char* msg, std::chrono::seconds retry_after);
+
+public:
+  std::chrono::seconds retry_after() const;
+
+private:
+  std::chrono::seconds retry_after_;
+};
+
+/**
+ * Thrown when an account exceeds its rate limit. Gets translated to
+ * HTTP 429 Too Many Requests with a Retry-After header, or the
+ * equivalent JSON-RPC error.
+ */
+class throttled : public std::runtime_error
+{
+public:
+  throttled(std::chrono::seconds retry_after);
+
+public:
+  std::chrono::seconds retry_after() const;
+
+private:
+  std::chrono::seconds retry_after_;
+};
+
 }  // namespace sentio::kurier
\ No newline at end of file
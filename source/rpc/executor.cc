@@ -0,0 +1,34 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "executor.h"
+#include "utils/log.h"
+
+namespace sentio::rpc
+{
+
+executor::executor(size_t compute_threads, size_t blocking_threads)
+  : compute_(compute_threads)
+  , blocking_(blocking_threads)
+  , compute_queued_(metrics::registry::instance().add_gauge(
+      "rpc_executor_queued_calls", "Calls waiting for an executor thread",
+      {{"pool", "compute"}}))
+  , blocking_queued_(metrics::registry::instance().add_gauge(
+      "rpc_executor_queued_calls", "", {{"pool", "blocking"}}))
+  , async_pending_(metrics::registry::instance().add_gauge(
+      "rpc_executor_suspended_calls", 
+      "Async calls started and waiting on remote services"))
+{
+  infolog << "rpc executor started with " << compute_threads
+          << " compute threads and " << blocking_threads
+          << " blocking threads";
+}
+
+executor::~executor()
+{
+  compute_.join();
+  blocking_.join();
+}
+
+}
@@ -0,0 +1,142 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <exception>
+#include <boost/asio/post.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/any_io_executor.hpp>
+
+#include "service.h"
+#include "utils/json.h"
+#include "utils/metrics.h"
+
+namespace sentio::rpc
+{
+
+/**
+ * Decides on which threads the JSON-RPC calls are executed.
+ *
+ * Network threads only parse requests and write responses, the services
+ * themselves run on one of two pools depending on their declared workload:
+ *
+ *  - light calls are executed inline on the session strand, they are cheap
+ *    enough that hopping threads would cost more than running them.
+ *
+ *  - compute calls run on a pool bounded to the number of cores, so a burst
+ *    of trip optimizations can't starve the network threads.
+ *
+ *  - blocking calls spend most of their time waiting on remote services
+ *    (DynamoDB, SQS), they run on a separate, larger pool so they don't
+ *    occupy compute threads while idle.
+ *
+ *  - async calls are coroutines started on the session strand, they wait
+ *    on remote services without holding any thread, so their number is
+ *    not bounded by the size of a pool.
+ *
+ * In all cases the outcome is posted back to the session strand, so session
+ * state is never touched concurrently.
+ */
+class executor
+{
+public:
+  executor(size_t compute_threads, size_t blocking_threads);
+  ~executor();
+
+public:
+  /**
+   * Runs @c fn on the pool matching @c kind, then invokes
+   * handler(std::exception_ptr, result_t) on the @c completion executor.
+   * The exception pointer is set if @c fn has thrown.
+   */
+  template <typename Function, typename Handler>
+  void dispatch(
+    workload kind,
+    boost::asio::any_io_executor completion,
+    Function&& fn,
+    Handler&& handler)
+  {
+    // synchronous invocations of async services block
+    // their thread on the remote calls they await.
+    if (kind == workload::async) {
+      kind = workload::blocking;
+    }
+
+    auto* queued = kind == workload::compute ? &compute_queued_ 
+                 : kind == workload::blocking ? &blocking_queued_ 
+                 : nullptr;
+
+    auto task = [completion, queued,
+      fn = std::forward<Function>(fn),
+      handler = std::forward<Handler>(handler)]() mutable {
+        if (queued != nullptr) {
+          queued->sub();
+        }
+        result_t result;
+        std::exception_ptr error;
+        try {
+          result = fn();
+        } catch (...) {
+          error = std::current_exception();
+        }
+        boost::asio::post(completion,
+          [handler = std::move(handler), error,
+           result = std::move(result)]() mutable {
+            handler(error, std::move(result));
+          });
+      };
+
+    switch (kind) {
+      case workload::light:
+        boost::asio::post(completion, std::move(task));
+        break;
+      case workload::compute:
+        compute_queued_.add();
+        boost::asio::post(compute_, std::move(task));
+        break;
+      case workload::async:
+      case workload::blocking:
+        blocking_queued_.add();
+        boost::asio::post(blocking_, std::move(task));
+        break;
+    }
+  }
+
+  /**
+   * Starts the coroutine returned by fn() on the @c completion executor,
+   * then invokes handler(std::exception_ptr, result_t) on that executor
+   * once the coroutine completes. Used for calls of the async workload.
+   */
+  template <typename Function, typename Handler>
+  void spawn(
+    boost::asio::any_io_executor completion,
+    Function&& fn,
+    Handler&& handler)
+  {
+    async_pending_.add();
+    boost::asio::co_spawn(completion, std::forward<Function>(fn)(),
+      boost::asio::bind_executor(completion,
+        [pending = &async_pending_, handler = std::forward<Handler>(handler)]
+        (std::exception_ptr error, result_t result) mutable {
+          pending->sub();
+          handler(error, std::move(result));
+        }));
+  }
+
+public: // noncopyable
+  executor(executor const&) = delete;
+  executor& operator=(executor const&) = delete;
+
+private:
+  boost::asio::thread_pool compute_;
+  boost::asio::thread_pool blocking_;
+  metrics::gauge& compute_queued_;
+  metrics::gauge& blocking_queued_;
+  metrics::gauge& async_pending_;
+};
+
+}
@@ -0,0 +1,176 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "rate_limiter.h"
+#include "utils/log.h"
+
+#include <mutex>
+#include <algorithm>
+#include <functional>
+
+namespace sentio::rpc
+{
+
+namespace // detail
+{
+  /**
+   * How often a shard drops buckets that refilled completely.
+   */
+  constexpr std::chrono::nanoseconds sweep_interval = std::chrono::seconds(10);
+
+  int64_t nanoseconds(rate_limiter::clock::time_point t)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      t.time_since_epoch()).count();
+  }
+
+  std::string key_of(context const& ctx, std::string_view method)
+  {
+    std::string key;
+    key.reserve(ctx.idp.size() + ctx.uid.size() + method.size() + 2);
+    key.append(ctx.idp).append(1, '\n').append(ctx.uid);
+    if (!method.empty()) {
+      key.append(1, '\n').append(method);
+    }
+    return key;
+  }
+
+  provider_limits const* limits_of(
+    std::unordered_map<std::string, provider_limits> const& limits,
+    context const& ctx)
+  {
+    auto it = limits.find(ctx.idp);
+    return it != limits.end() ? &it->second : nullptr;
+  }
+}
+
+rate_limiter::rate_limiter(
+  std::unordered_map<std::string, provider_limits> const& limits)
+  : limits_(limits)
+  , throttled_accounts_(metrics::registry::instance().add_counter(
+      "rpc_throttled_calls_total", "Requests rejected by rate limits",
+      {{"scope", "account"}}))
+  , throttled_methods_(metrics::registry::instance().add_counter(
+      "rpc_throttled_calls_total", "", {{"scope", "method"}}))
+{
+  for (auto const& [idp, limits]: limits_) {
+    if (limits.account.has_value()) {
+      infolog << "rate limiting " << idp << " accounts to "
+              << limits.account->rate << " requests/s, burst "
+              << limits.account->burst;
+    }
+    for (auto const& [method, limit]: limits.methods) {
+      infolog << "rate limiting " << idp << " accounts to "
+              << limit.rate << " " << method << " calls/s, burst "
+              << limit.burst;
+    }
+  }
+
+  metrics::registry::instance().add_callback(
+    "rpc_rate_limit_buckets", "Rate limit buckets of recently active accounts",
+    {}, [this]() { return static_cast<double>(size()); });
+}
+
+std::optional<std::chrono::seconds> rate_limiter::acquire(
+  context const& ctx,
+  clock::time_point now)
+{
+  auto limits = limits_of(limits_, ctx);
+  if (limits == nullptr || !limits->account.has_value()) {
+    return std::nullopt;
+  }
+
+  auto wait = take(key_of(ctx, {}), *limits->account, now);
+  if (wait.has_value()) {
+    throttled_accounts_.add();
+  }
+  return wait;
+}
+
+std::optional<std::chrono::seconds> rate_limiter::acquire(
+  context const& ctx,
+  std::string_view method,
+  clock::time_point now)
+{
+  auto limits = limits_of(limits_, ctx);
+  if (limits == nullptr) {
+    return std::nullopt;
+  }
+
+  auto it = limits->methods.find(std::string(method));
+  if (it == limits->methods.end()) {
+    return std::nullopt;
+  }
+
+  auto wait = take(key_of(ctx, method), it->second, now);
+  if (wait.has_value()) {
+    throttled_methods_.add();
+  }
+  return wait;
+}
+
+/**
+ * A bucket allows a call at time t if after adding the call's emission
+ * interval to its theoretical arrival time, it is no further ahead of t
+ * than the time it takes to refill the whole burst.
+ */
+std::optional<std::chrono::seconds> rate_limiter::take(
+  std::string const& key,
+  rate_limit const& limit,
+  clock::time_point now)
+{
+  int64_t t = nanoseconds(now);
+  int64_t emission = static_cast<int64_t>(1e9 / limit.rate);
+  int64_t capacity = static_cast<int64_t>(
+    emission * std::max(1.0, limit.burst));
+
+  auto consume = [&](bucket& b) -> std::optional<std::chrono::seconds> {
+    int64_t tat = b.tat.load(std::memory_order_relaxed);
+    while (true) {
+      int64_t next = std::max(tat, t) + emission;
+      if (next - t > capacity) {
+        auto wait = std::chrono::ceil<std::chrono::seconds>(
+          std::chrono::nanoseconds(next - t - capacity));
+        return std::max(wait, std::chrono::seconds(1));
+      }
+      if (b.tat.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+        return std::nullopt;
+      }
+    }
+  };
+
+  auto& s = shards_[std::hash<std::string>()(key) % shard_count];
+  {
+    std::shared_lock lock(s.mutex);
+    if (auto it = s.buckets.find(key); it != s.buckets.end()) {
+      return consume(it->second);
+    }
+  }
+
+  std::unique_lock lock(s.mutex);
+  if (t >= s.next_sweep) {
+    sweep(s, t);
+  }
+  return consume(s.buckets[key]);
+}
+
+void rate_limiter::sweep(shard& s, int64_t now)
+{
+  std::erase_if(s.buckets, [now](auto const& kv) {
+    return kv.second.tat.load(std::memory_order_relaxed) <= now;
+  });
+  s.next_sweep = now + sweep_interval.count();
+}
+
+size_t rate_limiter::size() const
+{
+  size_t total = 0;
+  for (auto const& s: shards_) {
+    std::shared_lock lock(s.mutex);
+    total += s.buckets.size();
+  }
+  return total;
+}
+
+}
@@ -0,0 +1,102 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "server.h"
+#include "utils/metrics.h"
+
+namespace sentio::rpc
+{
+
+/**
+ * Keeps a single account from starving everyone else by limiting how
+ * often it may call the server, as configured for its identity provider.
+ *
+ * Buckets are implemented with the generic cell rate algorithm, which
+ * behaves exactly like a token bucket but keeps its whole state in one
+ * number, the time at which the bucket will be full again. Taking a token
+ * is a single compare-and-swap on that number.
+ *
+ * Buckets live in a table split into shards. Finding an existing bucket
+ * takes a shared lock of one shard, only creating a bucket takes it
+ * exclusively. A bucket that has been full for a while behaves the same
+ * as a new one, so those are dropped whenever a shard is swept, which
+ * bounds the table by the number of recently active accounts.
+ */
+class rate_limiter
+{
+public:
+  using clock = std::chrono::steady_clock;
+  static constexpr size_t shard_count = 32;
+
+public:
+  rate_limiter(std::unordered_map<std::string, provider_limits> const& limits);
+
+public: // noncopyable
+  rate_limiter(rate_limiter const&) = delete;
+  rate_limiter& operator=(rate_limiter const&) = delete;
+
+public:
+  /**
+   * Takes a token from the account bucket of the caller. Returns nothing
+   * if the request may proceed, otherwise how long to wait before retrying.
+   */
+  std::optional<std::chrono::seconds> acquire(
+    context const& ctx,
+    clock::time_point now = clock::now());
+
+  /**
+   * Takes a token from the bucket of the caller for the given method.
+   */
+  std::optional<std::chrono::seconds> acquire(
+    context const& ctx,
+    std::string_view method,
+    clock::time_point now = clock::now());
+
+  /**
+   * Number of buckets currently tracked.
+   */
+  size_t size() const;
+
+private:
+  struct bucket
+  {
+    // theoretical arrival time, nanoseconds since clock epoch
+    std::atomic<int64_t> tat{0};
+  };
+
+  struct alignas(64) shard
+  {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, bucket> buckets;
+    int64_t next_sweep = 0;
+  };
+
+private:
+  std::optional<std::chrono::seconds> take(
+    std::string const& key,
+    rate_limit const& limit,
+    clock::time_point now);
+
+  void sweep(shard& s, int64_t now);
+
+private:
+  std::unordered_map<std::string, provider_limits> const& limits_;
+  std::array<shard, shard_count> shards_;
+  metrics::counter& throttled_accounts_;
+  metrics::counter& throttled_methods_;
+};
+
+}
@@ -5,6 +5,9 @@
 #pragma once
 
 #include <string>
+#include <chrono>
+#include <vector>
+#include <optional>
 #include <unordered_map>
 
 #include "auth.h"
@@ -28,6 +31,59 @@ using service_map_t =
     >
   >;
 
+/**
+ * A network endpoint on which the server accepts connections.
+ *
+ * Interfaces are served by separate listeners, each with its own acceptor
+ * and threads, so long-lived WebSocket sessions and short HTTP calls don't
+ * compete for the same threads.
+ */
+struct interface {
+  enum class protocol {
+    http,       // http+jsonrpc, JSON-RPC over HTTP POST
+    websocket,  // ws+jsonrpc, JSON-RPC over WebSocket
+    any         // both, used when no interfaces are configured
+  };
+
+  protocol type;
+  std::string address;
+  uint16_t port;
+
+  /**
+   * Number of network threads of this listener, 0 picks a default
+   * based on the number of cores and the protocol.
+   */
+  size_t threads;
+
+  /**
+   * For HTTP, how long an idle persistent connection is kept open while
+   * waiting for the next request. For WebSockets, how long a connection
+   * may stay silent before it is closed, the server pings the client
+   * halfway through.
+   */
+  std::chrono::seconds idle_timeout;
+};
+
+/**
+ * A token bucket that refills at @c rate calls per second
+ * and holds at most @c burst calls.
+ */
+struct rate_limit {
+  double rate;
+  double burst;
+};
+
+/**
+ * Rate limits of the accounts of one identity provider. The @c account
+ * bucket counts requests, a batch or a WebSocket message is one request,
+ * and is checked before the request body is parsed. Buckets in @c methods
+ * count individual calls to a method. Every account has its own buckets.
+ */
+struct provider_limits {
+  std::optional<rate_limit> account;
+  std::unordered_map<std::string, rate_limit> methods;
+};
+
 /**
  * This type holds all the settings captured from the environment,
  * about the server configuration. Those settings are most often
@@ -35,17 +91,174 @@ using service_map_t =
  */
 struct config {
   /**
-   * The IP on which the server will listen for requests.
-   * Its recommended to use 0.0.0.0 (its also the default value if not
-   * specified).
+   * The interfaces on which the server listens for requests, as declared
+   * in rpc.interfaces. Configs without that section get one interface
+   * serving both protocols on rpc.address and rpc.port.
+   */
+  std::vector<interface> interfaces;
+
+  /**
+   * The maximum number of HTTP requests served over a single
+   * persistent connection. Once reached, the last response carries
+   * "Connection: close" and the socket is shut down. This spreads
+   * long-lived clients across instances behind the load balancer.
+   * The default value is 1000.
+   */
+  size_t keepalive_max_requests;
+
+  /**
+   * How long a client has to read an HTTP response before the
+   * connection is dropped. Requests are read within the idle timeout
+   * of their interface, the time spent executing them doesn't count
+   * against either. The default value is 30 seconds.
+   */
+  std::chrono::seconds write_timeout;
+
+  /**
+   * Limits applied to JSON-RPC 2.0 batch requests. Calls within a
+   * batch are executed concurrently by the rpc executor. Batches with
+   * more than @c max_size calls, or whose summed service cost estimate
+   * exceeds @c max_cost are rejected as a whole.
+   */
+  struct {
+    size_t max_size;
+    size_t max_cost;
+  } batch;
+
+  /**
+   * Sizes of the thread pools that execute JSON-RPC calls outside of
+   * the network threads. CPU heavy services run on @c compute_threads,
+   * services blocking on remote calls run on @c blocking_threads.
+   */
+  struct {
+    size_t compute_threads;
+    size_t blocking_threads;
+  } execution;
+
+  /**
+   * By default all connections are accepted and served from a single
+   * completion queue shared by a pool of network threads. When sharding
+   * is enabled, the server runs @c shards threads (one per core if 0),
+   * each with its own io_context and its own SO_REUSEPORT acceptor. The
+   * kernel load-balances connections between them and sessions stay on
+   * the thread that accepted them. Threads can be optionally pinned to
+   * cores with @c pin_threads.
+   */
+  struct {
+    bool enabled;
+    bool pin_threads;
+    size_t shards;
+  } sharding;
+
+  /**
+   * Settings for JSON-RPC over WebSocket connections. Calls on a single
+   * connection are executed concurrently and answered out of order. At
+   * most @c max_inflight calls can be executing or waiting to be written
+   * at any time, after which the server stops reading from the socket
+   * until some of them complete.
+   *
+   * Incoming messages larger than @c max_message_size bytes close the
+   * connection. Responses are serialized into chained buffers and sent
+   * as fragments of at most @c fragment_size bytes, so large trips are
+   * never copied into one contiguous block.
+   *
+   * The @c deflate section configures the permessage-deflate extension.
+   * Its zlib state is the largest part of an idle connection footprint,
+   * roughly 2^(window_bits+2) + 2^(mem_level+9) bytes for compression
+   * plus 2^window_bits for decompression, so smaller windows allow more
+   * concurrent connections at the cost of compression ratio.
+   */
+  struct {
+    size_t max_inflight;
+    size_t max_message_size;
+    size_t fragment_size;
+
+    struct {
+      bool enabled;
+      int window_bits;
+      int mem_level;
+      int comp_level;
+      bool server_no_context_takeover;
+      bool client_no_context_takeover;
+    } deflate;
+  } websocket;
+
+  /**
+   * Compression of JSON-RPC responses sent over HTTP, the encoding is
+   * negotiated from the Accept-Encoding header of each request. Bodies
+   * smaller than @c min_size bytes are sent as they are, compressing
+   * them costs more CPU than it saves on the wire. @c level is the zlib
+   * level used for gzip and deflate, @c zstd_level is used for zstd when
+   * the server is built with libzstd.
+   */
+  struct {
+    bool enabled;
+    size_t min_size;
+    int level;
+    int zstd_level;
+  } compression;
+
+  /**
+   * Requests can be broken down into timed spans: auth, parsing, waiting
+   * for admission, execution with the notable steps of the services, and
+   * serialization. With @c server_timing, HTTP responses report the spans
+   * of their request in a Server-Timing header. A @c sample_rate fraction
+   * of requests is written to @c file in the Chrome trace event format,
+   * through a queue of @c queue_size traces. Untraced requests cost one
+   * thread local read per span.
+   */
+  struct {
+    bool server_timing;
+    double sample_rate;
+    std::string file;
+    size_t queue_size;
+  } tracing;
+
+  /**
+   * Admission control protects latency of admitted calls under bursts.
+   *
+   * Every call holds a number of units equal to the cost estimated by its
+   * service (waypoints + 2 for trips) while it executes. Each method has a
+   * budget of @c method_limit units and each region (voivodeship) that
+   * calls load has its own bulkhead of @c region_limit units, both can be
+   * overridden per name in @c methods and @c regions. A limit of 0 means
+   * unlimited. A call that is larger than its budget is still admitted
+   * when nothing else is running in it.
+   *
+   * Calls that don't fit wait in a queue of at most @c queue_size entries
+   * for up to @c queue_timeout, and are admitted in order of arrival
+   * within their method and region. Calls that can't be queued or time
+   * out are rejected with HTTP 503 or a JSON-RPC error, both carrying a
+   * hint to retry after @c retry_after.
+   */
+  struct {
+    bool enabled;
+    size_t method_limit;
+    size_t region_limit;
+    std::unordered_map<std::string, size_t> methods;
+    std::unordered_map<std::string, size_t> regions;
+    size_t queue_size;
+    std::chrono::milliseconds queue_timeout;
+    std::chrono::seconds retry_after;
+  } admission;
+
+  /**
+   * When enabled, identical calls to idempotent services made by the same
+   * account while one of them is still executing are collapsed into that
+   * execution and all of them receive its result.
    */
-  std::string listen_ip;
+  struct {
+    bool enabled;
+  } coalescing;
 
   /**
-   * The port on which this server will be running.
-   * The default value is 5001.
+   * Per account rate limits, by the name of the identity provider that
+   * issued the account's token, read from the rate_limit section of the
+   * provider's entry in rpc.auth. Accounts of providers without limits
+   * are not limited. Throttled calls are rejected with HTTP 429 or the
+   * equivalent JSON-RPC error, both with a hint when to retry.
    */
-  uint16_t listen_port;
+  std::unordered_map<std::string, provider_limits> rate_limits;
 
   /**
    * The set of authentication methods and configurations that allow 
@@ -4,11 +4,20 @@
 
 #pragma once
 
+#include <memory>
+#include <string>
 #include <optional>
+#include <functional>
+#include <boost/json/value.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/use_future.hpp>
 #include <boost/property_tree/ptree.hpp>
 
 #include "utils/json.h"
+#include "utils/json_encode.h"
 
 namespace sentio::rpc
 {
@@ -20,6 +29,74 @@ struct context
   boost::asio::ip::tcp::endpoint remote_ep;
 };
 
+/**
+ * Parameters of a JSON-RPC call, as parsed from the request. Services
+ * decode them directly into their typed request structures using the
+ * helpers in utils/json_decode.h.
+ */
+using params_t = boost::json::value;
+
+/**
+ * The result of a call, written straight into the response buffer once
+ * the call completes. Services return either a property tree or any
+ * value that json::write can serialize, like model types that describe
+ * their fields.
+ */
+class result_t
+{
+public:
+  result_t() = default;
+
+  template <typename T>
+  result_t(T value) requires requires(json::writer& w, T const& v) { json::write(w, v); }
+    : write_([v = std::make_shared<T const>(std::move(value))]
+             (json::writer& w) { json::write(w, *v); }) {}
+
+public:
+  void write(json::writer& w) const
+  {
+    if (write_) {
+      write_(w);
+    } else {
+      w.null();
+    }
+  }
+
+private:
+  std::function<void(json::writer&)> write_;
+};
+
+/**
+ * Declares the dominant cost of serving a call, used by the rpc
+ * executor to pick the threads on which the call is executed.
+ */
+enum class workload
+{
+  /**
+   * Cheap calls that are served inline on network threads.
+   */
+  light,
+
+  /**
+   * CPU heavy calls, like route optimization, that are executed
+   * on a bounded compute pool.
+   */
+  compute,
+
+  /**
+   * Calls that mostly wait on network round trips to external
+   * services, executed on a dedicated pool of blocking threads.
+   */
+  blocking,
+
+  /**
+   * Calls that wait on external services through asynchronous APIs.
+   * They are awaited on the session executor and hold no thread while
+   * suspended, see service_base::invoke_async.
+   */
+  async
+};
+
 /**
  * Base class for all JSON-RPC HTTP request handler.
  */
@@ -32,10 +109,47 @@ public:
    */
   virtual bool authenticated() const { return true; }
 
+  /**
+   * Declares whether calls to this service are cheap, CPU heavy or 
+   * blocking on I/O. This decides where the call gets executed.
+   */
+  virtual workload profile() const { return workload::light; }
+
   /**
    * Implements the main per-perquest service logic.
    */
-  virtual json_t invoke(json_t params, context ctx) const = 0;
+  virtual result_t invoke(params_t const& params, context ctx) const = 0;
+
+  /**
+   * The coroutine variant of invoke, awaited for services that declare
+   * the async workload. Services that override it implement invoke with
+   * block_on, so they can still be called synchronously.
+   */
+  virtual boost::asio::awaitable<result_t> invoke_async(
+    params_t const& params, context ctx) const
+  { co_return invoke(params, std::move(ctx)); }
+
+  /**
+   * A rough, relative estimate of how expensive it is to serve a call
+   * with the given parameters. Used to limit the total amount of work
+   * a single batch request can submit. Most calls cost 1 unit.
+   */
+  virtual size_t cost(params_t const&) const { return 1; }
+
+  /**
+   * Names the region whose resources (OSRM instance, address book) a call
+   * with the given parameters will use, or an empty string if the call is
+   * not bound to a region. Admission control keeps a separate budget for
+   * every region, so a burst in one voivodeship doesn't starve the others.
+   */
+  virtual std::string partition(params_t const&) const { return {}; }
+
+  /**
+   * Returns true if identical calls made by the same account at the same
+   * time may share one execution and its result. Only worth declaring for
+   * expensive services whose results depend on nothing but the parameters.
+   */
+  virtual bool idempotent() const { return false; }
 
   /**
    * For derived classes destruction.
@@ -54,6 +168,21 @@ public: // default trivial constructor
   service_base() = default;
 };
 
+/**
+ * Runs an awaitable to completion on the calling thread and returns
+ * its result or rethrows its exception. Meant for callers outside of
+ * the rpc server, it blocks for as long as the operation takes.
+ */
+template <typename T>
+T block_on(boost::asio::awaitable<T> task)
+{
+  boost::asio::io_context context;
+  auto result = boost::asio::co_spawn(
+    context, std::move(task), boost::asio::use_future);
+  context.run();
+  return result.get();
+}
+
 /**
  * A shorthand for creating an instance of a JSON-RPC method handler
  * and wrapping it in an unique_ptr.
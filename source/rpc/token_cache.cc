@@ -0,0 +1,89 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "token_cache.h"
+
+#include <mutex>
+#include <algorithm>
+#include <openssl/sha.h>
+
+namespace sentio::rpc
+{
+
+token_cache::token_cache(size_t capacity)
+  : shard_capacity_(std::max<size_t>(1, capacity / shard_count))
+{
+}
+
+token_cache::digest token_cache::hash(std::string_view token)
+{
+  digest output;
+  SHA256(reinterpret_cast<const unsigned char*>(token.data()),
+    token.size(), output.data());
+  return output;
+}
+
+// the table hashes the leading bytes of the digest, shards
+// are picked by a different byte so they are independent.
+token_cache::shard& token_cache::shard_of(digest const& key)
+{ return shards_[key[31] % shard_count]; }
+
+token_cache::shard const& token_cache::shard_of(digest const& key) const
+{ return shards_[key[31] % shard_count]; }
+
+std::optional<identity> token_cache::find(
+  std::string_view token,
+  uint64_t generation,
+  clock::time_point now) const
+{
+  auto key = hash(token);
+  auto const& s = shard_of(key);
+
+  std::shared_lock lock(s.mutex);
+  auto it = s.entries.find(key);
+  if (it == s.entries.end() ||
+      it->second.generation != generation ||
+      it->second.expires <= now) {
+    return std::nullopt;
+  }
+  return it->second.who;
+}
+
+void token_cache::insert(
+  std::string_view token,
+  identity who,
+  clock::time_point expires,
+  uint64_t generation)
+{
+  auto key = hash(token);
+  auto& s = shard_of(key);
+  auto now = clock::now();
+
+  std::unique_lock lock(s.mutex);
+  if (s.entries.size() >= shard_capacity_ && !s.entries.contains(key)) {
+    std::erase_if(s.entries, [&](auto const& kv) {
+      return kv.second.expires <= now || kv.second.generation != generation;
+    });
+    if (s.entries.size() >= shard_capacity_) {
+      s.entries.erase(s.entries.begin());
+    }
+  }
+  s.entries.insert_or_assign(key, entry {
+    .who = std::move(who),
+    .expires = expires,
+    .generation = generation
+  });
+}
+
+size_t token_cache::size() const
+{
+  size_t total = 0;
+  for (auto const& s: shards_) {
+    std::shared_lock lock(s.mutex);
+    total += s.entries.size();
+  }
+  return total;
+}
+
+}
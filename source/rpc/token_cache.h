@@ -0,0 +1,105 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace sentio::rpc
+{
+
+/**
+ * Who a verified access token belongs to.
+ */
+struct identity
+{
+  std::string upn;  // user principal name
+  std::string idp;  // identity provider
+};
+
+/**
+ * Remembers tokens that passed signature verification, so a client that
+ * sends the same token with every request pays for the RSA check once.
+ *
+ * Entries are keyed by the SHA-256 of the token, the token itself is not
+ * kept in memory. An entry is valid until the token expires and only for
+ * the generation of the key set it was verified with, bumping the
+ * generation when keys rotate invalidates everything cached before.
+ *
+ * The table is split into shards with their own lock, lookups take a
+ * shared lock of one shard. Each shard holds at most capacity / shards
+ * entries, when one is full expired entries are dropped first, then an
+ * arbitrary one.
+ */
+class token_cache
+{
+public:
+  using clock = std::chrono::system_clock;
+  static constexpr size_t shard_count = 16;
+
+public:
+  explicit token_cache(size_t capacity);
+
+public: // noncopyable
+  token_cache(token_cache const&) = delete;
+  token_cache& operator=(token_cache const&) = delete;
+
+public:
+  std::optional<identity> find(
+    std::string_view token,
+    uint64_t generation,
+    clock::time_point now = clock::now()) const;
+
+  void insert(
+    std::string_view token,
+    identity who,
+    clock::time_point expires,
+    uint64_t generation);
+
+  size_t size() const;
+
+private:
+  using digest = std::array<unsigned char, 32>;
+
+  struct digest_hash
+  {
+    size_t operator()(digest const& d) const
+    {
+      size_t h;
+      std::memcpy(&h, d.data(), sizeof(h));
+      return h;
+    }
+  };
+
+  struct entry
+  {
+    identity who;
+    clock::time_point expires;
+    uint64_t generation;
+  };
+
+  struct alignas(64) shard
+  {
+    mutable std::shared_mutex mutex;
+    std::unordered_map<digest, entry, digest_hash> entries;
+  };
+
+  static digest hash(std::string_view token);
+  shard& shard_of(digest const& key);
+  shard const& shard_of(digest const& key) const;
+
+private:
+  size_t shard_capacity_;
+  std::array<shard, shard_count> shards_;
+};
+
+}
@@ -4,14 +4,34 @@
 
 #include "web.h"
 #include "error.h"
+#include "executor.h"
+#include "admission.h"
+#include "coalescer.h"
+#include "buffer_pool.h"
+#include "compression.h"
+#include "rate_limiter.h"
 #include "utils/log.h"
 #include "utils/meta.h"
+#include "utils/metrics.h"
+#include "utils/trace.h"
+#include "utils/json_decode.h"
 
 #include <list>
+#include <deque>
+#include <atomic>
 #include <thread>
+#include <cstring>
+#include <vector>
+#include <functional>
+
+#include <pthread.h>
 
 #include <boost/beast/websocket.hpp>
+#include <boost/beast/core/ostream.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/json/parse.hpp>
+#include <boost/json/serialize.hpp>
+#include <boost/json/monotonic_resource.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/exception/diagnostic_information.hpp>
 
@@ -23,6 +43,11 @@ namespace web = boost::beast;
 namespace ws = web::websocket;
 using tcp = net::ip::tcp;
 
+/**
+ * A parsed JSON-RPC request, or a batch of them.
+ */
+using request_t = boost::json::value;
+
 
 namespace // detail
 {
@@ -33,15 +58,248 @@ namespace // detail
            req.target() == "/healthcheck";
   }
 
+  template <typename BodyType>
+  bool is_metrics(web::http::request<BodyType> const& req)
+  {
+    return req.method() == web::http::verb::get && 
+           req.target() == "/metrics";
+  }
+
   template <typename BodyType>
   bool is_cors_options(web::http::request<BodyType> const& req)
   {
     return req.method() == web::http::verb::options && 
            req.target() == "/";
   }
+
+  /**
+   * Thrown when a request body is not a valid JSON document.
+   */
+  class parse_error : public bad_request
+  {
+  public:
+    parse_error() : bad_request("parse error") {}
+  };
+
+  /**
+   * Parses a JSON-RPC request straight out of the network buffer.
+   * 
+   * All nodes of the document are allocated from one arena that is freed 
+   * at once, together with the last node that refers to it. The arena is 
+   * not thread safe, so after parsing requests and their parts are only 
+   * ever moved or read, never copied, while they travel between threads.
+   */
+  request_t parse_request(std::string_view text)
+  {
+    trace::span timing("parse");
+    boost::json::error_code ec;
+    auto output = boost::json::parse(text, ec, 
+      boost::json::make_shared_resource<boost::json::monotonic_resource>());
+    if (ec) {
+      throw parse_error();
+    }
+    return output;
+  }
+
+  /**
+   * JSON-RPC 2.0 batch requests are JSON arrays of request objects.
+   * An empty array is served as a single invalid request.
+   */
+  bool is_batch(request_t const& request)
+  {
+    return request.is_array() && !request.get_array().empty();
+  }
+
+  /**
+   * The name of the method invoked by a call, or an
+   * empty string if the request doesn't name one.
+   */
+  std::string method_of(request_t const& request)
+  {
+    auto method = json::find(request, "method");
+    if (method == nullptr || !method->is_string()) {
+      return {};
+    }
+    return std::string(method->get_string());
+  }
+
+  /**
+   * JSON-RPC ids are either strings or numbers and have to be echoed
+   * back with the same type. They are kept as serialized JSON, which
+   * also outlives the memory of the parsed request.
+   */
+  std::optional<std::string> id_of(request_t const& request)
+  {
+    if (auto id = json::find(request, "id"); id != nullptr) {
+      if (id->is_string() || id->is_number()) {
+        return boost::json::serialize(*id);
+      }
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * Translates an exception thrown while handling a JSON-RPC call
+   * into a JSON-RPC 2.0 error object. Details of internal errors are
+   * logged but never sent to the client.
+   */
+  json_t rpc_error(std::exception_ptr eptr)
+  {
+    auto make_error = [](int code, const char* message) {
+      json_t output;
+      output.add("code", code);
+      output.add("message", message);
+      return output;
+    };
+
+    try {
+      std::rethrow_exception(eptr);
+    } catch (parse_error const&) {
+      return make_error(-32700, "parse error");
+    } catch (bad_method const& e) {
+      return make_error(-32601, e.what());
+    } catch (bad_request const& e) {
+      return make_error(-32600, e.what());
+    } catch (std::invalid_argument const& e) {
+      return make_error(-32602, e.what());
+    } catch (not_authorized const& e) {
+      return make_error(-32001, e.what());
+    } catch (overloaded const& e) {
+      auto output = make_error(-32003, e.what());
+      output.add("data.retry_after", e.retry_after().count());
+      return output;
+    } catch (throttled const& e) {
+      auto output = make_error(-32004, e.what());
+      output.add("data.retry_after", e.retry_after().count());
+      return output;
+    } catch (...) {
+      return make_error(-32603, "internal error");
+    }
+  }
+
+  /**
+   * The outcome of a single JSON-RPC call.
+   */
+  struct reply
+  {
+    std::optional<std::string> id;  // as JSON, see id_of
+    result_t result;
+    std::exception_ptr error;
+  };
+
+  /**
+   * Writes the JSON-RPC 2.0 response envelope of a call,
+   * with either its result or its error.
+   */
+  void write(json::writer& w, reply const& r)
+  {
+    w.begin_object();
+    w.key("jsonrpc");
+    w.string("2.0");
+    if (r.id.has_value()) {
+      w.key("id");
+      w.raw(r.id.value());
+    }
+    if (r.error) {
+      w.key("error");
+      json::write(w, rpc_error(r.error));
+    } else {
+      w.key("result");
+      r.result.write(w);
+    }
+    w.end_object();
+  }
+
+  /**
+   * Writes the JSON representation of a reply, or of a batch of them,
+   * directly into a dynamic buffer.
+   */
+  template <typename Payload, typename DynamicBuffer>
+  void serialize(Payload const& payload, DynamicBuffer& buffer)
+  {
+    json::writer w(buffer);
+    write(w, payload);
+  }
+
+  /**
+   * Logs calls that failed while executing.
+   */
+  void log_call_error(std::exception_ptr eptr)
+  {
+    try {
+      std::rethrow_exception(eptr);
+    } catch (std::exception const& e) {
+      errlog << "rpc call error: " << e.what();
+    } catch (...) {
+      errlog << "rpc call error: unknown error";
+    }
+  }
 }
 
 
+/**
+ * Metrics recorded by web sessions. All series are registered once when
+ * the server starts, sessions only record into them.
+ */
+class session_metrics
+{
+public:
+  session_metrics(config const& config, service_map_t const& services)
+    : unknown_calls_(metrics::registry::instance().add_histogram(
+        "rpc_call_duration_seconds", "JSON-RPC call latency, including "
+        "time spent waiting for admission", {{"method", "unknown"}}))
+    , auth(metrics::registry::instance().add_histogram(
+        "rpc_auth_duration_seconds", "Time spent verifying access tokens"))
+    , inflight(metrics::registry::instance().add_gauge(
+        "rpc_inflight_calls", "JSON-RPC calls admitted and not yet completed"))
+    , rejected(metrics::registry::instance().add_counter(
+        "rpc_rejected_calls_total", "JSON-RPC calls rejected by admission control"))
+    , received(metrics::registry::instance().add_counter(
+        "rpc_received_bytes_total", "Bytes read from HTTP and WebSocket clients"))
+    , sent(metrics::registry::instance().add_counter(
+        "rpc_sent_bytes_total", "Bytes written to HTTP and WebSocket clients"))
+  {
+    for (auto const& [method, svc]: services) {
+      calls_.emplace(method, &metrics::registry::instance().add_histogram(
+        "rpc_call_duration_seconds", "", {{"method", method}}));
+    }
+
+    for (auto const& iface: config.interfaces) {
+      auto name = name_of(iface);
+      memory_.emplace(name, &metrics::registry::instance().add_gauge(
+        "rpc_session_memory_bytes", "Estimated memory held by the "
+        "connections of an interface", {{"interface", name}}));
+    }
+  }
+
+public:
+  metrics::histogram& latency_of(std::string const& method) const
+  {
+    auto it = calls_.find(method);
+    return it != calls_.end() ? *it->second : unknown_calls_;
+  }
+
+  metrics::gauge& memory_of(interface const& iface) const
+  { return *memory_.at(name_of(iface)); }
+
+private:
+  static std::string name_of(interface const& iface)
+  { return iface.address + ":" + std::to_string(iface.port); }
+
+private:
+  std::unordered_map<std::string, metrics::histogram*> calls_;
+  std::unordered_map<std::string, metrics::gauge*> memory_;
+  metrics::histogram& unknown_calls_;
+
+public:
+  metrics::histogram& auth;
+  metrics::gauge& inflight;
+  metrics::counter& rejected;
+  metrics::counter& received;
+  metrics::counter& sent;
+};
+
+
 /**
  * Handles the state needed to maintain a connection with a connected client.
  * This data structure is maintained for each open connection, so be conservative
@@ -50,9 +308,6 @@ namespace // detail
 class web_session
   : public std::enable_shared_from_this<web_session>
 {
-public:
-  static constexpr size_t buffer_size = 64 * 1024; // 64KB
-
 private:  // types
   /**
    * This type of body is used only to signal HTTP error
@@ -65,41 +320,111 @@ private:  // types
    */
   using string_body_t = web::http::string_body;
 
-  using buffer_type = web::flat_static_buffer<buffer_size> ;
+  /**
+   * Input buffers start empty, grow on demand up to the message size 
+   * limit and are released back to the shared pool whenever the 
+   * connection goes idle.
+   */
+  using buffer_type = web::basic_flat_buffer<pooled_allocator<char>>;
+
+  /**
+   * Responses are serialized into a chain of pooled blocks rather than
+   * one contiguous string, so large results are built once and never
+   * reallocated or copied while growing.
+   */
+  using chained_buffer = web::basic_multi_buffer<pooled_allocator<char>>;
+  using chained_body_t = web::http::basic_dynamic_body<chained_buffer>;
+
   using stream_type = web::websocket::stream<web::tcp_stream>;
-  using socket_type = tcp::socket;
+  using socket_type = web::tcp_stream;
   using request_type = web::http::request<string_body_t>;
-  using response_type = web::http::response<string_body_t>;
+  using response_type = web::http::response<chained_body_t>;
   using error_response_type = web::http::response<error_body_t>;
 
+  /**
+   * Invoked on the session executor with the gathered
+   * array of responses once all calls in a batch complete.
+   */
+  using batch_handler = std::function<void(std::vector<reply>)>;
+
+  /**
+   * Shared between all in-flight calls of one batch request.
+   * The last call to complete hands the responses to the handler.
+   */
+  struct batch_state 
+  {
+    batch_state(size_t count, batch_handler h)
+      : responses(count), pending(count), handler(std::move(h)) {}
+
+    std::vector<reply> responses;
+    std::atomic<size_t> pending;
+    batch_handler handler;
+  };
+
 public:
   /**
    * Create a new websocket session from a connected socket and take over ownership
    * of all resources associated with this connection.
    */
   web_session(
-    socket_type&& socket,
-    auth const& guard,
-    service_map_t const& services)
+    tcp::socket&& socket,
+    config const& config,
+    interface const& iface,
+    service_map_t const& services,
+    executor& executor,
+    admission& admission,
+    rate_limiter& limiter,
+    coalescer& coalescer,
+    trace::exporter* tracer,
+    session_metrics const& metrics)
   : socket_(std::move(socket))
-  , guard_(guard)
+  , strand_(socket_.get_executor())
+  , ibuffer_(config.websocket.max_message_size)
+  , guard_(config.guard)
+  , config_(config)
+  , iface_(iface)
   , services_(services)
-  , ioctx_(*socket_.get_executor().target<net::io_context>())
+  , executor_(executor)
+  , admission_(admission)
+  , limiter_(limiter)
+  , coalescer_(coalescer)
+  , tracer_(tracer)
+  , metrics_(metrics)
+  , memory_(metrics.memory_of(iface))
 {
   tracelog << "web session started";
 }
 
 ~web_session()
-{ tracelog << "web session destructed"; }
+{ 
+  memory_.sub(static_cast<int64_t>(footprint_));
+  tracelog << "web session destructed"; 
+}
 
 public:
   void start()
-  { http_start(); }
+  { 
+    report_footprint();
+    http_start(); 
+  }
 
-  void http_start(web::error_code = web::error_code(), size_t = 0)
+  /**
+   * Reads the next request on this connection. 
+   * 
+   * HTTP/1.1 connections are persistent by default, so this gets
+   * called again after every response that was not marked with
+   * "Connection: close". Pipelined requests that arrived together
+   * with the previous one are already sitting in the input buffer
+   * and will be parsed without touching the socket.
+   */
+  void http_start()
   {
     request_ = request_type(); 
     response_ = response_type();
+    trace_.reset();
+    eresponse_ = error_response_type();
+    release_idle_buffers();
+    socket_.expires_after(iface_.idle_timeout);
     web::http::async_read(socket_, ibuffer_, request_, 
       web::bind_front_handler(
         &web_session::on_http_read, shared_from_this()));
@@ -110,15 +435,26 @@ private:
   {
     wsctx_ = context;
     ws_->auto_fragment(false);
-    ws_->read_message_max(buffer_size);
+    ws_->read_message_max(config_.websocket.max_message_size);
+
+    auto const& deflate = config_.websocket.deflate;
     ws_->set_option(ws::permessage_deflate {
-      .server_enable = true,
-      .client_enable = true,
-      .compLevel = 3
+      .server_enable = deflate.enabled,
+      .client_enable = deflate.enabled,
+      .server_max_window_bits = deflate.window_bits,
+      .client_max_window_bits = deflate.window_bits,
+      .server_no_context_takeover = deflate.server_no_context_takeover,
+      .client_no_context_takeover = deflate.client_no_context_takeover,
+      .compLevel = deflate.comp_level,
+      .memLevel = deflate.mem_level
     });
-    ws_->set_option(
-      ws::stream_base::timeout::suggested(
-        web::role_type::server));
+    // silent clients are pinged halfway through the idle
+    // timeout and disconnected if they don't respond.
+    auto timeout = ws::stream_base::timeout::suggested(
+      web::role_type::server);
+    timeout.idle_timeout = iface_.idle_timeout;
+    timeout.keep_alive_pings = true;
+    ws_->set_option(timeout);
     
     ws_->async_accept(
       request_,
@@ -127,20 +463,195 @@ private:
         shared_from_this()));
   }
 
-  json_t invoke_rpc_method(json_t request, context const& ctx)
+  /**
+   * Finds the service handling the method named in a request. Returns
+   * nullptr for malformed requests and unknown methods, those fail later
+   * in route_call with the appropriate error.
+   */
+  service_base const* find_service(request_t const& request) const
   {
-    std::string method;
-    std::optional<std::string> msgid;
-    boost::property_tree::ptree params;
+    auto svcit = services_.find(method_of(request));
+    return svcit != services_.end() ? svcit->second.get() : nullptr;
+  }
 
-    // attempt to parse JSON request and extract required fields
-    // we're going to fail the request if its not a valid JSON
-    // or one of the required fields is missing.
-    try {
-      params = request.get_child("params");
-      msgid = to_std(request.get_optional<std::string>("id"));
-      method = request.get<std::string>("method");
-    } catch (...) {
+  workload profile_of(request_t const& request) const
+  {
+    auto svc = find_service(request);
+    return svc != nullptr ? svc->profile() : workload::light;
+  }
+
+  /**
+   * Starts the trace of a request if it is sampled for export or its
+   * timings are reported back to the client, otherwise returns nullptr
+   * and the request runs untraced.
+   */
+  std::shared_ptr<trace::request_trace> start_trace(const char* name) const
+  {
+    bool sampled = tracer_ != nullptr && tracer_->sample();
+    if (!sampled && !config_.tracing.server_timing) {
+      return nullptr;
+    }
+    return std::make_shared<trace::request_trace>(name, sampled);
+  }
+
+  void finish_trace(std::shared_ptr<trace::request_trace> const& tracing) const
+  {
+    if (tracing && tracing->sampled()) {
+      tracer_->submit(*tracing);
+    }
+  }
+
+  /**
+   * Admits a call through rate limits and admission control and then
+   * invokes its method on the executor, as a call of the given workload.
+   * The handler is invoked on the session strand with the outcome, or with
+   * a throttled or overloaded exception if the call was rejected. The 
+   * admission permit is held until the handler returns.
+   *
+   * Calls to idempotent services that are identical to a call already in
+   * flight are not executed again, they receive the outcome of that call.
+   * Only the call that executes records its spans into its trace.
+   */
+  template <typename Handler>
+  void schedule_call(
+    request_t request,
+    workload kind,
+    context const& ctx,
+    std::shared_ptr<trace::request_trace> tracing,
+    Handler&& handler)
+  {
+    auto started = std::chrono::steady_clock::now();
+
+    // method names come from the client, unknown ones all share
+    // the empty name so they can't grow the per-method tables.
+    auto svc = find_service(request);
+    admission::ticket ticket {
+      .method = svc != nullptr ? method_of(request) : std::string(),
+      .region = {},
+      .cost = 1
+    };
+
+    if (auto wait = limiter_.acquire(ctx, ticket.method)) {
+      handler(std::make_exception_ptr(throttled(*wait)), result_t());
+      return;
+    }
+
+    // malformed calls are admitted at the minimum cost,
+    // they fail quickly once executed.
+    std::optional<coalescer::digest> flight;
+    if (svc != nullptr) {
+      if (auto params = json::find(request, "params")) {
+        try {
+          ticket.cost = svc->cost(*params);
+          ticket.region = svc->partition(*params);
+          if (config_.coalescing.enabled && svc->idempotent()) {
+            flight = coalescer::key_of(ticket.method, ctx, *params);
+          }
+        } catch (...) {}
+      }
+    }
+
+    if (!flight.has_value()) {
+      admit_call(std::move(request), kind, ctx, std::move(ticket), 
+        started, std::move(tracing), std::forward<Handler>(handler));
+      return;
+    }
+
+    if (coalescer_.join(*flight, strand_, std::forward<Handler>(handler))) {
+      admit_call(std::move(request), kind, ctx, std::move(ticket), started,
+        std::move(tracing), [&flights = coalescer_, key = *flight]
+        (std::exception_ptr error, result_t result) {
+          flights.complete(key, error, std::move(result));
+        });
+    }
+  }
+
+  /**
+   * Queues a call for admission and runs it on the executor once admitted.
+   */
+  template <typename Handler>
+  void admit_call(
+    request_t request,
+    workload kind,
+    context const& ctx,
+    admission::ticket ticket,
+    std::chrono::steady_clock::time_point started,
+    std::shared_ptr<trace::request_trace> tracing,
+    Handler&& handler)
+  {
+    auto& latency = metrics_.latency_of(ticket.method);
+    admission_.admit(std::move(ticket), strand_,
+      [self = shared_from_this(), kind, started, &latency, ctx,
+       request = std::move(request), tracing = std::move(tracing),
+       handler = std::forward<Handler>(handler)]
+      (std::exception_ptr error, admission::permit permit) mutable {
+        if (error) {
+          self->metrics_.rejected.add();
+          handler(error, result_t());
+          return;
+        }
+        auto admitted = std::chrono::steady_clock::now();
+        if (tracing) {
+          tracing->record("admission", started, admitted);
+        }
+
+        self->metrics_.inflight.add();
+        auto completion = [self, started, admitted, &latency, tracing,
+          permit = std::move(permit), handler = std::move(handler)]
+          (std::exception_ptr error, result_t result) mutable {
+            self->metrics_.inflight.sub();
+            if (error) {
+              log_call_error(error);
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (tracing) {
+              // from admission until the outcome is back on the
+              // strand, including the wait in the executor queue.
+              tracing->record("execute", admitted, now);
+            }
+            latency.record(now - started);
+            handler(error, std::move(result));
+          };
+
+        if (kind == workload::async) {
+          self->executor_.spawn(self->strand_,
+            [self, ctx, tracing, request = std::move(request)]() mutable {
+              return invoke_rpc_method_async(
+                self, std::move(request), ctx, tracing);
+            }, std::move(completion));
+        } else {
+          self->executor_.dispatch(kind, self->strand_,
+            [self, ctx, tracing, request = std::move(request)]() {
+              trace::scope traced(tracing.get());
+              trace::span timing("invoke");
+              return self->invoke_rpc_method(request, ctx);
+            }, std::move(completion));
+        }
+      });
+  }
+
+  /**
+   * Charges a request to the account rate limit of the caller. This runs
+   * before the request is parsed, so flooding clients cost little.
+   */
+  void throttle(context const& ctx)
+  {
+    if (auto wait = limiter_.acquire(ctx)) {
+      throw throttled(*wait);
+    }
+  }
+
+  /**
+   * Finds the service that handles a call, or throws the JSON-RPC error
+   * of malformed requests and unknown methods.
+   */
+  service_base const& route_call(request_t const& request) const
+  {
+    // the request is already a valid JSON document, fail it 
+    // if one of the required JSON-RPC fields is missing.
+    auto method = method_of(request);
+    auto params = json::find(request, "params");
+    if (method.empty() || params == nullptr) {
       throw bad_request();
     }
 
@@ -151,39 +662,200 @@ private:
       errlog << "unknown rpc method: " << method;
       throw bad_method(method.c_str());
     }
+    return *svcit->second;
+  }
 
-    return svcit->second->invoke(std::move(params), ctx);
+  result_t invoke_rpc_method(request_t const& request, context const& ctx) const
+  {
+    return route_call(request).invoke(*json::find(request, "params"), ctx);
   }
 
-  void process_ws_request() 
-  { 
-    json_t output;
-    output.add("jsonrpc", "2.0");
+  /**
+   * Awaits a call of the async workload. The coroutine owns the request
+   * and keeps the session alive while it is suspended.
+   *
+   * Its invoke span is recorded directly into the trace, trace scopes
+   * are per thread and must not stay open across a suspension.
+   */
+  static net::awaitable<result_t> invoke_rpc_method_async(
+    std::shared_ptr<web_session> self, request_t request, context ctx,
+    std::shared_ptr<trace::request_trace> tracing)
+  {
+    auto started = trace::clock::now();
+    std::exception_ptr error;
+    result_t result;
+    try {
+      auto const& service = self->route_call(request);
+      result = co_await service.invoke_async(
+        *json::find(request, "params"), std::move(ctx));
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    if (tracing) {
+      tracing->record("invoke", started, trace::clock::now());
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    co_return result;
+  }
+
+  /**
+   * Rejects batches that exceed the configured number of calls or
+   * their combined cost, as estimated by the individual services.
+   */
+  void verify_batch_limits(boost::json::array const& batch) const
+  {
+    if (batch.size() > config_.batch.max_size) {
+      throw bad_request("batch too large");
+    }
+
+    size_t cost = 0;
+    for (auto const& call: batch) {
+      auto svc = find_service(call);
+      auto params = json::find(call, "params");
+      if (svc != nullptr && params != nullptr) {
+        cost += svc->cost(*params);
+      } else {
+        cost += 1; // will fail anyway
+      }
+    }
+
+    if (cost > config_.batch.max_cost) {
+      throw bad_request("batch too expensive");
+    }
+  }
 
+  /**
+   * Fans out every call of a JSON-RPC 2.0 batch to the executor, so 
+   * independent calls run concurrently. Light calls are moved to the
+   * compute pool for that purpose. Once the last one completes, responses
+   * are gathered in request order and the handler is invoked on the 
+   * session strand.
+   */
+  void invoke_rpc_batch(
+    request_t batch,
+    context const& ctx,
+    std::shared_ptr<trace::request_trace> const& tracing,
+    batch_handler handler)
+  {
+    auto& calls = batch.get_array();
+    verify_batch_limits(calls);
+    auto state = std::make_shared<batch_state>(
+      calls.size(), std::move(handler));
+
+    size_t index = 0;
+    for (auto& call: calls) {
+      auto kind = profile_of(call);
+      if (kind == workload::light) {
+        kind = workload::compute;
+      }
+
+      auto id = id_of(call);
+      schedule_call(std::move(call), kind, ctx, tracing,
+        [state, index, id = std::move(id)]
+        (std::exception_ptr error, result_t result) mutable {
+          // completions are serialized on the session strand
+          state->responses[index] = reply {
+            .id = std::move(id),
+            .result = std::move(result),
+            .error = error
+          };
+          if (--state->pending == 0) {
+            state->handler(std::move(state->responses));
+          }
+        });
+      ++index;
+    }
+  }
+
+  void process_ws_request(std::string_view message) 
+  { 
     try {
-      json_t parsed_request;
-      std::stringstream ss;
-      ss.write((char*)ibuffer_.data().data(), ibuffer_.data().size());
-      tracelog << "ws request: " << ss.str();
-      boost::property_tree::read_json(ss, parsed_request);
-      if (auto id = parsed_request.get_optional<std::string>("id"); id.has_value()) {
-        output.add("id", id.value());
+      tracelog << "ws request: " << message;
+      throttle(*wsctx_);
+      auto tracing = start_trace("ws.message");
+      trace::scope traced(tracing.get());
+      auto parsed_request = parse_request(message);
+
+      if (is_batch(parsed_request)) {
+        invoke_rpc_batch(std::move(parsed_request), *wsctx_, tracing,
+          [self = shared_from_this(), tracing](std::vector<reply> replies) {
+            self->ws_write_response(replies, tracing);
+          });
+      } else {
+        auto kind = profile_of(parsed_request);
+        auto id = id_of(parsed_request);
+        schedule_call(std::move(parsed_request), kind, *wsctx_, tracing,
+          [self = shared_from_this(), tracing, id = std::move(id)]
+          (std::exception_ptr error, result_t result) mutable {
+            self->ws_write_response(reply {
+              .id = std::move(id),
+              .result = std::move(result),
+              .error = error
+            }, tracing);
+          });
       }
-      output.add_child("result", invoke_rpc_method(parsed_request, *wsctx_));
     } catch (std::exception const& e) {
       errlog << "ws process error: " << e.what();
-      output.add("error.message", "unspecified error");
+      ws_write_response(reply {
+        .id = std::nullopt,
+        .result = {},
+        .error = std::current_exception()
+      });
+    }
+  }
+
+  /**
+   * Called on the session strand when a call completes. Responses are
+   * written in completion order, not request order, clients correlate
+   * them with their requests using the JSON-RPC id.
+   */
+  template <typename Payload>
+  void ws_write_response(
+    Payload const& output,
+    std::shared_ptr<trace::request_trace> const& tracing = nullptr)
+  {
+    --inflight_;
+    if (ws_closed_) {
+      return; // nobody to deliver it to
     }
 
-    std::stringstream ssout;
-    boost::property_tree::write_json(ssout, output, false);
-    std::string serialized = ssout.str();
-    tracelog << "ws response: " << serialized;
-    
-    auto write = obuffer_.prepare(serialized.size());
-    std::copy(serialized.begin(), serialized.end(), 
-      reinterpret_cast<char*>(write.data()));
-    obuffer_.commit(serialized.size());
+    {
+      trace::scope traced(tracing.get());
+      trace::span timing("serialize");
+      serialize(output, wqueue_.emplace_back());
+    }
+    report_footprint();
+    finish_trace(tracing);
+    tracelog << "ws response: " << web::make_printable(wqueue_.back().data());
+
+    if (!ws_writing_) {
+      ws_write_next();
+    }
+  }
+
+  /**
+   * Sends the next fragment of the message at the front of the queue.
+   * Large responses go out as a sequence of frames of at most the 
+   * configured fragment size, the last one carrying the FIN bit.
+   * Messages are never interleaved, the next one starts only after
+   * the last fragment of the current one was written.
+   */
+  void ws_write_next()
+  {
+    ws_writing_ = true;
+    auto const& message = wqueue_.front();
+    auto fragment = web::buffers_prefix(
+      config_.websocket.fragment_size, message.data());
+    bool fin = web::buffer_bytes(fragment) == message.size();
+
+    ws_->text(true);
+    ws_->async_write_some(fin, fragment,
+      web::bind_front_handler(
+        &web_session::on_ws_write, 
+        shared_from_this()));
   }
 
   void process_http_request() 
@@ -192,54 +864,70 @@ private:
     if (is_healthcheck(request_)) {
       confirm_healthcheck();
       return;
+    } else if (is_metrics(request_)) {
+      serve_metrics();
+      return;
     } else if (is_cors_options(request_)) { 
       cors_headers_response();
       return;
     }
 
-    json_t parsed_request;
-    std::stringstream ss(request_.body());
+    trace_ = start_trace("http.request");
+    trace::scope traced(trace_.get());
 
     // authentication & authorization
     context request_context(
       get_context_from_token(
-        socket_, request_.base()));
+        socket_.socket(), request_.base()));
 
     // This server handles only JSON-RPC requests which are JSON objects
     // sent through POST to one of the exposed endpoints, all other verbs
     // are not supported.
     if (request_.method() == web::http::verb::post) {
-      boost::property_tree::read_json(ss, parsed_request);
-      tracelog << "http request: " << ss.str();
+      if (iface_.type == interface::protocol::websocket) {
+        throw bad_method("JSON-RPC over HTTP is not served on this interface");
+      }
+
+      tracelog << "http request: " << request_.body();
+      throttle(request_context);
+      auto parsed_request = parse_request(request_.body());
 
-      json_t rpcresult;
-      rpcresult.add("jsonrpc", "2.0");
-      if (auto id = parsed_request.get_optional<std::string>("id"); id.has_value()) {
-        rpcresult.add("id", id.value());
+      if (is_batch(parsed_request)) {
+        // batches always succeed at the HTTP level, failures
+        // of individual calls are reported as JSON-RPC errors.
+        invoke_rpc_batch(std::move(parsed_request), request_context, trace_,
+          [self = shared_from_this()](std::vector<reply> replies) {
+            self->http_write_response(replies);
+          });
+        return;
       }
-      rpcresult.add_child("result", invoke_rpc_method(
-        parsed_request, request_context));
-
-      std::stringstream outss;
-      boost::property_tree::write_json(outss, rpcresult, false);
-      tracelog << "http response: " << outss.str();
-      response_.body() = outss.str();
-      apply_cors_headers(response_);
-      response_.keep_alive(false);
-      response_.set(
-        web::http::field::content_type, 
-        "application/json; charset=utf-8");
-      response_.prepare_payload();
-
-      web::http::async_write(socket_, response_, 
-        web::bind_front_handler(
-          &web_session::http_close,
-          shared_from_this()));
+
+      // single calls report failures through HTTP status codes
+      auto kind = profile_of(parsed_request);
+      auto id = id_of(parsed_request);
+      schedule_call(std::move(parsed_request), kind, request_context, trace_,
+        [self = shared_from_this(), id = std::move(id)]
+        (std::exception_ptr error, result_t result) mutable {
+          if (error) {
+            self->fail_http_request(error);
+          } else {
+            self->http_write_response(reply {
+              .id = std::move(id),
+              .result = std::move(result),
+              .error = nullptr
+            });
+          }
+        });
 
     } else if (web::websocket::is_upgrade(request_)) {
+      if (iface_.type == interface::protocol::http) {
+        throw bad_request("websockets are not served on this interface");
+      }
+
       // alternatively clients can establish a websocket connection
       // and send the same json-rpc calls without reestablishing
-      // connections.
+      // connections. Websocket streams manage their own timeouts.
+      socket_.expires_never();
       ws_.emplace(stream_type(std::move(socket_)));
       accept_ws_session(request_context);
     } else {
@@ -249,6 +937,86 @@ private:
     }
   };
 
+  template <typename Payload>
+  void http_write_response(Payload const& rpcresult)
+  {
+    trace::scope traced(trace_.get());
+    {
+      trace::span timing("serialize");
+      serialize(rpcresult, response_.body());
+    }
+    tracelog << "http response: " << web::make_printable(response_.body().data());
+    compress_response();
+    complete_http_trace(response_);
+    response_.version(request_.version());
+    apply_cors_headers(response_);
+    response_.keep_alive(keep_alive());
+    response_.set(
+      web::http::field::content_type, 
+      "application/json; charset=utf-8");
+    response_.prepare_payload();
+
+    http_send(response_, response_.keep_alive());
+  }
+
+  /**
+   * Reports the timings of the current HTTP request in the Server-Timing
+   * header of its response, if enabled, and exports its trace if sampled.
+   * Time spent writing the response to the socket is not included.
+   */
+  template <typename Response>
+  void complete_http_trace(Response& response)
+  {
+    if (!trace_) {
+      return;
+    }
+    if (config_.tracing.server_timing) {
+      response.set("Server-Timing", trace_->server_timing());
+    }
+    finish_trace(trace_);
+    trace_.reset();
+  }
+
+  /**
+   * Replaces the serialized body with its compressed form when the client
+   * accepts one of the supported encodings and the body is large enough
+   * for compression to pay off. Runs on the network thread, which reuses
+   * its compressor between responses.
+   */
+  void compress_response()
+  {
+    auto const& settings = config_.compression;
+    if (!settings.enabled) {
+      return;
+    }
+
+    response_.set(web::http::field::vary, "Accept-Encoding");
+    if (response_.body().size() < settings.min_size) {
+      return;
+    }
+
+    auto accepted = request_[web::http::field::accept_encoding];
+    auto encoding = compression::negotiate(
+      std::string_view(accepted.data(), accepted.size()));
+    if (encoding == compression::encoding::identity) {
+      return;
+    }
+
+    trace::span timing("compress");
+    chained_buffer compressed;
+    size_t size = compression::compress(encoding,
+      encoding == compression::encoding::zstd
+        ? settings.zstd_level : settings.level,
+      response_.body().data(), compressed);
+
+    // incompressible bodies are sent as they are
+    if (size < response_.body().size()) {
+      response_.body() = std::move(compressed);
+      response_.set(web::http::field::content_encoding,
+        std::string(compression::name_of(encoding)));
+    }
+  }
+
   context get_context_from_token(
       boost::asio::ip::tcp::socket const& socket,
       web::http::header<true, web::http::fields> const& headers)
@@ -264,10 +1032,17 @@ private:
     std::string_view tokenview(authval.data(), authval.size());
     tokenview.remove_prefix(prefix.size());
 
-    if (auto decoded = guard_.authorize(tokenview); decoded.has_value()) {
+    std::optional<identity> decoded;
+    {
+      metrics::stopwatch timing(metrics_.auth);
+      trace::span section("auth");
+      decoded = guard_.authorize(tokenview);
+    }
+
+    if (decoded.has_value()) {
       return context {
-        .uid = decoded->get<std::string>("upn"),
-        .idp = decoded->get<std::string>("idp"),
+        .uid = std::move(decoded->upn),
+        .idp = std::move(decoded->idp),
         .remote_ep = socket.remote_endpoint()
       };
     } else {
@@ -285,51 +1060,135 @@ private:
     res.set(field::access_control_allow_credentials, "true");
   }
 
+  /**
+   * The server starts listening only after all services are constructed
+   * and their routing engines loaded and warmed up, so an instance that
+   * answers health checks is ready to take traffic.
+   */
   void confirm_healthcheck()
   {
-    auto const& ep = socket_.remote_endpoint();
+    auto const& ep = socket_.socket().remote_endpoint();
     dbglog << "health check from " << ep << ": ok";
+    eresponse_.version(request_.version());
     eresponse_.result(web::http::status::ok);
-    eresponse_.keep_alive(false);
-    web::http::async_write(socket_, eresponse_, 
-      web::bind_front_handler(
-        &web_session::http_close, 
-        shared_from_this()));
+    eresponse_.keep_alive(keep_alive());
+    eresponse_.prepare_payload();
+    http_send(eresponse_, eresponse_.keep_alive());
+  }
+
+  /**
+   * Renders all process metrics in the Prometheus text format.
+   */
+  void serve_metrics()
+  {
+    {
+      auto os = web::ostream(response_.body());
+      metrics::registry::instance().render(os);
+    }
+    response_.version(request_.version());
+    response_.result(web::http::status::ok);
+    response_.keep_alive(keep_alive());
+    response_.set(
+      web::http::field::content_type, 
+      "text/plain; version=0.0.4; charset=utf-8");
+    response_.prepare_payload();
+
+    http_send(response_, response_.keep_alive());
   }
 
   void cors_headers_response()
   {
+    eresponse_.version(request_.version());
     eresponse_.result(web::http::status::ok);
-    eresponse_.keep_alive(false);
+    eresponse_.keep_alive(keep_alive());
     apply_cors_headers(eresponse_);
+    eresponse_.prepare_payload();
 
-    web::http::async_write(socket_, eresponse_, 
-      web::bind_front_handler(
-        &web_session::http_start, 
-        shared_from_this()));
+    http_send(eresponse_, eresponse_.keep_alive());
+  }
+
+  /**
+   * Decides whether the connection should stay open after the
+   * current response. The client has to ask for it (HTTP/1.1 default)
+   * and the connection must not exceed its configured request quota.
+   */
+  bool keep_alive() const
+  { 
+    return request_.keep_alive() && 
+      served_ < config_.keepalive_max_requests; 
   }
 
 private:
   void ws_async_read() {
+    ws_reading_ = true;
     ibuffer_.clear();
+    release_idle_buffers();
     ws_->async_read(ibuffer_, web::bind_front_handler(
       &web_session::on_ws_read, shared_from_this()));
   }
 
-  void on_http_read(web::error_code ec, size_t)
+  /**
+   * Reads the next message unless this connection reached its cap of
+   * calls that are either executing or waiting to be written. Not reading
+   * lets the TCP window fill up, which pushes back on the client.
+   */
+  void ws_resume_read()
   {
+    if (ws_reading_ || ws_closed_) {
+      return;
+    }
+
+    if (inflight_ + wqueue_.size() < config_.websocket.max_inflight) {
+      ws_async_read();
+    }
+  }
+
+  void on_http_read(web::error_code ec, size_t bytes)
+  {
+    metrics_.received.add(bytes);
+    report_footprint();
+    if (ec == web::http::error::end_of_stream || 
+        ec == web::error::timeout) {
+      // client closed the connection or it stayed
+      // idle for longer than the keep-alive timeout.
+      return http_close();
+    }
+
     if (ec) {
-      if (ec != web::http::error::end_of_stream) {
-        errlog << "http socket error: " << ec.message();
-      }
+      errlog << "http socket error: " << ec.message();
       socket_.close();
       return;
     }
 
+    // the idle timeout only covers waiting for the request, admission
+    // and execution are bounded by their own limits.
+    socket_.expires_never();
+    ++served_;
     try {
       process_http_request();
+    } catch (...) {
+      fail_http_request(std::current_exception());
+    }
+  }
+
+  /**
+   * Translates exceptions thrown while serving a HTTP request
+   * into HTTP error responses.
+   */
+  void fail_http_request(std::exception_ptr eptr)
+  {
+    try {
+      std::rethrow_exception(eptr);
     } catch (not_authorized const& e) {
       return terminate_with_error(e, web::http::status::unauthorized);
+    } catch (overloaded const& e) {
+      eresponse_.set(web::http::field::retry_after, 
+        std::to_string(e.retry_after().count()));
+      return terminate_with_error(e, web::http::status::service_unavailable);
+    } catch (throttled const& e) {
+      eresponse_.set(web::http::field::retry_after, 
+        std::to_string(e.retry_after().count()));
+      return terminate_with_error(e, web::http::status::too_many_requests);
     } catch (bad_request const& e) {
       return terminate_with_error(e, web::http::status::bad_request);
     } catch (std::invalid_argument const& e) {
@@ -349,36 +1208,55 @@ private:
     }
   }
 
-  void on_ws_read(web::error_code ec, size_t)
+  void on_ws_read(web::error_code ec, size_t bytes)
   {
+    metrics_.received.add(bytes);
+    report_footprint();
+    ws_reading_ = false;
     if (ec) {
       if (ec != net::error::eof && 
+          ec != ws::error::closed &&
           ec != net::error::connection_reset) {
         errlog << "ws error: " << ec.message();  
       }
-      socket_.close();
+      ws_closed_ = true;
       return;
-    } else {
-      process_ws_request();
-      ws_->text(ws_->got_text());
-      ws_->async_write(obuffer_.data(), web::bind_front_handler(
-        &web_session::on_ws_write, shared_from_this()));
-    }
+    } 
+
+    // the call is dispatched to the executor and the next message
+    // is read right away, so a slow call doesn't hold up others
+    // sent over the same connection.
+    ++inflight_;
+    // parsed in place, the buffer is reused only after this returns
+    auto message = ibuffer_.data();
+    process_ws_request(std::string_view(
+      static_cast<const char*>(message.data()), message.size()));
+    ws_resume_read();
   }
 
-  void on_ws_write(web::error_code ec, size_t)
+  void on_ws_write(web::error_code ec, size_t bytes)
   {
+    metrics_.sent.add(bytes);
+    ws_writing_ = false;
     if (ec) {
       errlog << "ws error: " << ec.message();
+      ws_closed_ = true;
+      return;
     }
 
-    //obuffer_.consume(n);
-    obuffer_.clear(); 
-    ibuffer_.clear();
+    // blocks of the sent fragment go back to the pool right away
+    wqueue_.front().consume(bytes);
+    if (wqueue_.front().size() != 0) {
+      report_footprint();
+      return ws_write_next();
+    }
 
-    if (ws_->is_open()) { 
-      ws_async_read(); 
+    wqueue_.pop_front();
+    report_footprint();
+    if (!wqueue_.empty()) {
+      ws_write_next();
     }
+    ws_resume_read();
   }
 
   void on_ws_accept(web::error_code ec)
@@ -386,13 +1264,100 @@ private:
     if (ec) {
       errlog << "ws accept error: " << ec.message();
     } else {
-      dbglog << "ws accepted, reading bytes";
+      report_footprint();  // now holds the deflate state
+      auto pool = buffer_pool::instance().usage();
+      dbglog << "ws accepted, estimated session footprint: " 
+             << memory_footprint() << " bytes, buffer pool in use: "
+             << pool.in_use_bytes << " bytes, cached: " 
+             << pool.cached_bytes << " bytes";
       ws_async_read();
     }
   }
+
+  /**
+   * Gives the input buffer memory back to the pool when no partial 
+   * message is pending in it. The next read starts with a small block
+   * and grows only as much as the next message needs.
+   */
+  void release_idle_buffers()
+  {
+    if (ibuffer_.size() == 0) {
+      ibuffer_.shrink_to_fit();
+    }
+    report_footprint();
+  }
+
+  /**
+   * Adds the change of this connection's footprint since it was last
+   * reported to the memory gauge of its interface. Called wherever the
+   * buffers grow or shrink.
+   */
+  void report_footprint()
+  {
+    auto current = memory_footprint();
+    memory_.add(static_cast<int64_t>(current) - 
+      static_cast<int64_t>(footprint_));
+    footprint_ = current;
+  }
+
+  /**
+   * Estimates the number of bytes held by this connection: the session
+   * object, its buffers, queued responses and, for WebSockets, the zlib
+   * state of permessage-deflate (as documented in zconf.h).
+   */
+  size_t memory_footprint() const
+  {
+    size_t bytes = sizeof(*this) + ibuffer_.capacity();
+    for (auto const& response: wqueue_) {
+      bytes += response.capacity();
+    }
+
+    auto const& deflate = config_.websocket.deflate;
+    if (ws_.has_value() && deflate.enabled) {
+      bytes += (size_t(1) << (deflate.window_bits + 2)) + 
+               (size_t(1) << (deflate.mem_level + 9));  // deflate
+      bytes += (size_t(1) << deflate.window_bits) + 7 * 1024; // inflate
+    }
+    return bytes;
+  }
   
-  void http_close(web::error_code, size_t)
-  { socket_.close(); }
+  void on_http_write(bool keep_alive, web::error_code ec, size_t bytes)
+  {
+    metrics_.sent.add(bytes);
+    if (ec) {
+      errlog << "http write error: " << ec.message();
+      socket_.close();
+      return;
+    }
+
+    if (!keep_alive) {
+      return http_close();
+    }
+
+    // read the next request on this persistent connection
+    http_start();
+  }
+
+  /**
+   * Writes a response, the client has @c write_timeout to take it.
+   */
+  template <typename Message>
+  void http_send(Message& message, bool keep_alive)
+  {
+    socket_.expires_after(config_.write_timeout);
+    web::http::async_write(socket_, message,
+      web::bind_front_handler(
+        &web_session::on_http_write,
+        shared_from_this(),
+        keep_alive));
+  }
+
+  void http_close()
+  { 
+    web::error_code ec;
+    socket_.socket().shutdown(tcp::socket::shutdown_send, ec);
+    socket_.close();
+  }
 
 
   template <typename Exception>
@@ -400,18 +1365,17 @@ private:
     Exception const& e, 
     web::http::status status)
   {
-    auto const& ep = socket_.remote_endpoint();
+    auto const& ep = socket_.socket().remote_endpoint();
     errlog << "request error [" << ep << "]: " << e.what();
     errlog << boost::current_exception_diagnostic_information();
+    eresponse_.version(request_.version());
     eresponse_.result(status);     // HTTP error code (=/= 200)
     eresponse_.keep_alive(false);  // disconnect
     apply_cors_headers(eresponse_);
+    complete_http_trace(eresponse_);
     eresponse_.prepare_payload();  // serialize
 
-    web::http::async_write(socket_, eresponse_,
-      web::bind_front_handler(
-        &web_session::http_start, 
-        shared_from_this()));
+    http_send(eresponse_, false);
   }
 
   void on_ws_close(web::error_code ec)
@@ -419,51 +1383,133 @@ private:
 
 private:
   socket_type socket_;
+  net::any_io_executor strand_;
   std::optional<stream_type> ws_;
   buffer_type ibuffer_;
-  buffer_type obuffer_;
   request_type request_;
   response_type response_;
   error_response_type eresponse_;
+  std::shared_ptr<trace::request_trace> trace_;
   std::optional<context> wsctx_;
+  std::deque<chained_buffer> wqueue_;
+  size_t inflight_ = 0;
+  size_t served_ = 0;
+  bool ws_reading_ = false;
+  bool ws_writing_ = false;
+  bool ws_closed_ = false;
 
 private:
   auth const& guard_;
+  config const& config_;
+  interface const& iface_;
   service_map_t const& services_;
-  net::io_context& ioctx_;
+  executor& executor_;
+  admission& admission_;
+  rate_limiter& limiter_;
+  coalescer& coalescer_;
+  trace::exporter* tracer_;
+  session_metrics const& metrics_;
+  metrics::gauge& memory_;
+  size_t footprint_ = 0;  // last reported to memory_
 };
 
 
 class web_server::impl
 {
+private:
+  /**
+   * SO_REUSEPORT lets multiple sockets bind to the same address and port,
+   * the kernel then load-balances incoming connections between them.
+   */
+  using reuse_port = net::detail::socket_option::boolean<
+    SOL_SOCKET, SO_REUSEPORT>;
+
+  /**
+   * A completion queue together with an acceptor that feeds it.
+   *
+   * In the default mode a listener has only one shard that is run by a 
+   * pool of threads. In sharded mode every thread runs its own shard with
+   * its own SO_REUSEPORT acceptor, so accepted sessions stay on the thread
+   * that accepted them and threads never contend on a shared queue.
+   */
+  struct shard 
+  {
+    shard(tcp::endpoint const& ep, int concurrency_hint, bool reuseport)
+      : ioctx(concurrency_hint)
+      , acceptor(ioctx)
+    {
+      acceptor.open(ep.protocol());
+      acceptor.set_option(net::socket_base::reuse_address(true));
+      if (reuseport) {
+        acceptor.set_option(reuse_port(true));
+      }
+      acceptor.bind(ep);
+      acceptor.listen(net::socket_base::max_listen_connections);
+    }
+
+    net::io_context ioctx;
+    tcp::acceptor acceptor;
+  };
+
+  /**
+   * Accepts connections on one configured interface and runs
+   * their sessions on threads that belong to this interface only.
+   */
+  struct listener
+  {
+    interface const& iface;
+    size_t threads;
+    std::vector<std::unique_ptr<shard>> shards;
+  };
+
 public:
   impl(
-    tcp::endpoint ep,
-    auth const& guard,
+    config const& config,
     service_map_t const& services)
-  : guard_(guard)
+  : config_(config)
   , services_(services)
-  , acceptor_(ioctx_)
+  , executor_(
+      config.execution.compute_threads,
+      config.execution.blocking_threads)
+  , admission_(config)
+  , limiter_(config.rate_limits)
+  , tracer_(config.tracing.file.empty() ? nullptr
+      : std::make_unique<trace::exporter>(
+          config.tracing.file,
+          config.tracing.sample_rate,
+          config.tracing.queue_size))
+  , metrics_(config, services)
 {
-  acceptor_.open(ep.protocol());
-  acceptor_.set_option(net::socket_base::reuse_address(true));
-  acceptor_.bind(ep);
-  acceptor_.listen(net::socket_base::max_listen_connections);
+  for (auto const& iface: config.interfaces) {
+    listeners_.emplace_back(create_listener(iface));
+  }
 }
 
 public:
   void start() {
     
     std::list<std::thread> instances;
-    size_t concurrency = std::thread::hardware_concurrency() * 2;
-    
-    for (size_t i = 0; i < concurrency; ++i) {
-      instances.emplace_back(std::thread([this](){
-        BOOST_LOG_SCOPED_THREAD_TAG("tid", 
-          sentio::logging::assign_thread_id());
-        accept_next();
-        ioctx_.run();
-      }));
+    size_t cpu = 0;
+
+    for (auto& lst: listeners_) {
+      for (size_t i = 0; i < lst.threads; ++i) {
+        // in sharded mode every thread runs its own shard, 
+        // optionally pinned to a core.
+        auto& target = config_.sharding.enabled 
+          ? *lst.shards[i] 
+          : *lst.shards.front();
+        bool pin = config_.sharding.enabled && config_.sharding.pin_threads;
+        size_t core = cpu++ % std::thread::hardware_concurrency();
+
+        instances.emplace_back(std::thread([this, &target, pin, core]() {
+          BOOST_LOG_SCOPED_THREAD_TAG("tid", 
+            sentio::logging::assign_thread_id());
+          if (pin) {
+            pin_current_thread(core);
+          }
+          target.ioctx.run();
+        }));
+      }
     }
 
     for (auto& th: instances) {
@@ -474,10 +1520,77 @@ public:
   }
 
 private:
-  void accept_next()
+  listener create_listener(interface const& iface)
+  {
+    tcp::endpoint ep(
+      net::ip::address::from_string(iface.address), 
+      iface.port);
+
+    listener output { .iface = iface, .threads = iface.threads, .shards = {} };
+    if (output.threads == 0) {
+      // WebSocket sessions are long lived and mostly idle between
+      // calls, HTTP connections turn over quickly and need more
+      // threads to accept and parse requests.
+      size_t cores = std::thread::hardware_concurrency();
+      if (config_.sharding.enabled && config_.sharding.shards != 0) {
+        output.threads = config_.sharding.shards;
+      } else if (iface.type == interface::protocol::websocket) {
+        output.threads = cores;
+      } else {
+        output.threads = cores * 2;
+      }
+    }
+
+    if (config_.sharding.enabled) {
+      for (size_t i = 0; i < output.threads; ++i) {
+        output.shards.emplace_back(std::make_unique<shard>(ep, 1, true));
+      }
+    } else {
+      output.shards.emplace_back(std::make_unique<shard>(
+        ep, static_cast<int>(output.threads), false));
+    }
+
+    for (auto& target: output.shards) {
+      accept_next(*target, iface);
+    }
+
+    infolog << "listening for " << protocol_name(iface.type) 
+            << " on " << ep << " using " << output.threads << " threads"
+            << (config_.sharding.enabled ? " with SO_REUSEPORT shards" : "");
+    return output;
+  }
+
+  static const char* protocol_name(interface::protocol type)
   {
-    acceptor_.async_accept(
-    [this](web::error_code ec, tcp::socket socket) {
+    switch (type) {
+      case interface::protocol::http: return "http+jsonrpc";
+      case interface::protocol::websocket: return "ws+jsonrpc";
+      default: return "http+jsonrpc and ws+jsonrpc";
+    }
+  }
+
+  static void pin_current_thread(size_t cpu)
+  {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    int result = pthread_setaffinity_np(
+      pthread_self(), sizeof(cpu_set_t), &cpuset);
+    if (result != 0) {
+      warnlog << "failed to pin network thread to cpu " << cpu 
+              << ": " << std::strerror(result);
+    } else {
+      dbglog << "network thread pinned to cpu " << cpu;
+    }
+  }
+
+  void accept_next(shard& target, interface const& iface)
+  {
+    // every session gets its own strand, so completions posted
+    // from the executor pools never run concurrently with its
+    // network handlers.
+    target.acceptor.async_accept(net::make_strand(target.ioctx),
+    [this, &target, &iface](web::error_code ec, tcp::socket socket) {
       if (ec) {
         errlog << "ip connection accept error: " << ec.message();
       } else {
@@ -485,31 +1598,31 @@ private:
         // session that will self destruct when its closed. Its
         // lifetime is managed by the enabled_shared_from_this mechanism.
         std::make_shared<web_session>(
-          std::move(socket), guard_, services_)->start();
+          std::move(socket), config_, iface, services_, 
+          executor_, admission_, limiter_, coalescer_, tracer_.get(),
+          metrics_)->start();
       }
-      accept_next();
+      accept_next(target, iface);
     });
   }
 
 private:
-  auth const& guard_;
+  config const& config_;
   service_map_t const& services_;
-  boost::asio::io_context ioctx_;
-  boost::asio::ip::tcp::acceptor acceptor_;
+  executor executor_;
+  admission admission_;
+  rate_limiter limiter_;
+  coalescer coalescer_;
+  std::unique_ptr<trace::exporter> tracer_;
+  session_metrics metrics_;
+  std::vector<listener> listeners_;
 };
 
-tcp::endpoint from_config(config const& config) {
-  return tcp::endpoint(
-    net::ip::address::from_string(config.listen_ip),
-    config.listen_port);
-}
-
 web_server::~web_server() {}
 web_server::web_server(
   config const& config,
   service_map_t const& services)
-  : impl_(std::make_unique<impl>(
-      from_config(config), config.guard, services))
+  : impl_(std::make_unique<impl>(config, services))
 { }
 
 void web_server::start()
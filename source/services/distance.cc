@@ -5,10 +5,85 @@
 #include "distance.h"
 #include "rpc/error.h"
 #include "spacial/coords.h"
+#include "utils/json_decode.h"
+
+#include <boost/archive/iterators/transform_width.hpp>
+#include <boost/archive/iterators/base64_from_binary.hpp>
 
 namespace sentio::services 
 {
 
+namespace // detail
+{
+  std::vector<spacial::coordinates> coordinates_at(
+    rpc::params_t const& params, std::string_view key)
+  {
+    return boost::json::value_to<std::vector<spacial::coordinates>>(
+      json::at(params, key));
+  }
+
+  /**
+   * Number of coordinates in one of the matrix params, 
+   * without decoding them.
+   */
+  size_t count_at(rpc::params_t const& params, std::string_view key)
+  {
+    auto value = json::find(params, key);
+    return value != nullptr && value->is_array() 
+      ? value->get_array().size() : 0;
+  }
+
+  bool optional_flag(rpc::params_t const& params, std::string_view key)
+  {
+    auto value = json::find(params, key);
+    if (value == nullptr) {
+      return false;
+    }
+    if (!value->is_bool()) {
+      throw std::invalid_argument(std::string(key) + " must be a boolean");
+    }
+    return value->get_bool();
+  }
+
+  matrix_response::rows_type to_rows(
+    std::vector<int32_t> const& values, size_t rows, size_t columns)
+  {
+    matrix_response::rows_type output(rows);
+    for (size_t r = 0; r < rows; ++r) {
+      output[r].reserve(columns);
+      for (size_t c = 0; c < columns; ++c) {
+        auto value = values[r * columns + c];
+        output[r].push_back(value >= 0 
+          ? std::optional<int32_t>(value) : std::nullopt);
+      }
+    }
+    return output;
+  }
+
+  /**
+   * Encodes values as little-endian int32 in base64, padded to a
+   * multiple of four characters.
+   */
+  std::string to_base64(std::vector<int32_t> const& values)
+  {
+    std::string bytes;
+    bytes.reserve(values.size() * sizeof(int32_t));
+    for (auto value: values) {
+      auto bits = static_cast<uint32_t>(value);
+      for (int shift = 0; shift < 32; shift += 8) {
+        bytes.push_back(static_cast<char>((bits >> shift) & 0xff));
+      }
+    }
+
+    using namespace boost::archive::iterators;
+    using encoder = base64_from_binary<
+      transform_width<std::string::const_iterator, 6, 8>>;
+    std::string output(encoder(bytes.begin()), encoder(bytes.end()));
+    output.append((3 - bytes.size() % 3) % 3, '=');
+    return output;
+  }
+}
+
 distance_service::distance_service(
   routing::config const& config,
   spacial::index const& index,
@@ -16,10 +91,21 @@ distance_service::distance_service(
   : index_(index)
   , instancesmap_(config, sources) { }
 
-json_t distance_service::invoke(json_t params, rpc::context) const 
+std::string distance_service::partition(rpc::params_t const& params) const
+{
+  if (auto from = json::find(params, "from"); from != nullptr) {
+    auto coords = boost::json::value_to<spacial::coordinates>(*from);
+    if (auto region = index_.locate(coords)) {
+      return region->name();
+    }
+  }
+  return {};
+}
+
+rpc::result_t distance_service::invoke(rpc::params_t const& params, rpc::context) const 
 {
-  spacial::coordinates to(params.get_child("to"));
-  spacial::coordinates from(params.get_child("from"));
+  auto to = boost::json::value_to<spacial::coordinates>(json::at(params, "to"));
+  auto from = boost::json::value_to<spacial::coordinates>(json::at(params, "from"));
   
   auto to_region = index_.locate(to);
   auto from_region = index_.locate(from);
@@ -42,4 +128,91 @@ json_t distance_service::invoke(json_t params, rpc::context) const
   return output;
 }
 
-}
\ No newline at end of file
+distance_matrix_service::distance_matrix_service(
+  routing::config const& config,
+  spacial::index const& index,
+  std::vector<import::region_paths> const& sources)
+  : index_(index)
+  , max_locations_(config.max_matrix_locations)
+  , instancesmap_(config, sources) { }
+
+size_t distance_matrix_service::cost(rpc::params_t const& params) const
+{
+  // a table query is far cheaper per pair than a route,
+  // a hundred pairs cost about as much as one route.
+  auto cells = count_at(params, "sources") * count_at(params, "destinations");
+  return 1 + cells / 100;
+}
+
+std::string distance_matrix_service::partition(rpc::params_t const& params) const
+{
+  if (auto sources = json::find(params, "sources"); 
+      sources != nullptr && sources->is_array() && 
+      !sources->get_array().empty()) {
+    auto coords = boost::json::value_to<spacial::coordinates>(
+      sources->get_array().front());
+    if (auto region = index_.locate(coords)) {
+      return region->name();
+    }
+  }
+  return {};
+}
+
+rpc::result_t distance_matrix_service::invoke(
+  rpc::params_t const& params, rpc::context) const 
+{
+  auto sources = coordinates_at(params, "sources");
+  auto destinations = coordinates_at(params, "destinations");
+  bool durations_only = optional_flag(params, "durations_only");
+  auto encoding = json::optional_string(params, "encoding").value_or("json");
+  if (encoding != "json" && encoding != "base64") {
+    throw rpc::bad_request("unsupported matrix encoding");
+  }
+
+  if (sources.empty() || destinations.empty()) {
+    throw rpc::bad_request("empty matrix");
+  }
+
+  if (sources.size() + destinations.size() > max_locations_) {
+    throw rpc::bad_request("matrix too large");
+  }
+
+  std::optional<spacial::region> region;
+  for (auto const* points: { &sources, &destinations }) {
+    for (auto const& point: *points) {
+      auto located = index_.locate(point);
+      if (!located) {
+        throw rpc::bad_request("region not found");
+      }
+      if (region && region != located) {
+        throw rpc::bad_request("cross region routing not supported");
+      }
+      region = std::move(located);
+    }
+  }
+
+  auto matrix = instancesmap_.calculate_matrix(
+    sources, destinations, region->name(), !durations_only);
+
+  if (encoding == "base64") {
+    return packed_matrix_response {
+      .rows = matrix.rows,
+      .columns = matrix.columns,
+      .encoding = "int32le+base64",
+      .durations = to_base64(matrix.durations),
+      .distances = durations_only ? std::nullopt
+        : std::optional<std::string>(to_base64(matrix.distances))
+    };
+  }
+
+  return matrix_response {
+    .rows = matrix.rows,
+    .columns = matrix.columns,
+    .durations = to_rows(matrix.durations, matrix.rows, matrix.columns),
+    .distances = durations_only ? std::nullopt
+      : std::optional<matrix_response::rows_type>(
+          to_rows(matrix.distances, matrix.rows, matrix.columns))
+  };
+}
+
+}
@@ -4,6 +4,11 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <optional>
+
 #include "rpc/service.h"
 #include "spacial/index.h"
 #include "routing/osrm_interop.h"
@@ -21,12 +26,104 @@ public:
     std::vector<import::region_paths> const& sources);
 
 public:
-  json_t invoke(
-    json_t params, 
-    rpc::context ctx) const;
+  rpc::result_t invoke(
+    rpc::params_t const& params, 
+    rpc::context ctx) const override;
+
+  rpc::workload profile() const override
+  { return rpc::workload::compute; }
+
+  bool idempotent() const override { return true; }
+
+  std::string partition(rpc::params_t const& params) const override;
+
+private:
+  spacial::index const& index_;
+  routing::osrm_map instancesmap_;
+};
+
+/**
+ * The travel matrix in the JSON shape, one array per source with
+ * one value per destination. Pairs with no route are null.
+ */
+struct matrix_response
+{
+  using rows_type = std::vector<std::vector<std::optional<int32_t>>>;
+
+  size_t rows;
+  size_t columns;
+  rows_type durations;
+  std::optional<rows_type> distances;
+};
+
+constexpr auto json_fields(matrix_response const*)
+{
+  return std::make_tuple(
+    json::field("rows", &matrix_response::rows),
+    json::field("columns", &matrix_response::columns),
+    json::field("durations", &matrix_response::durations),
+    json::field("distances", &matrix_response::distances));
+}
+
+/**
+ * The travel matrix in the compact shape, every matrix is a base64
+ * string of rows * columns little-endian int32 values in row-major
+ * order, with -1 for pairs that have no route.
+ */
+struct packed_matrix_response
+{
+  size_t rows;
+  size_t columns;
+  std::string encoding;
+  std::string durations;
+  std::optional<std::string> distances;
+};
+
+constexpr auto json_fields(packed_matrix_response const*)
+{
+  return std::make_tuple(
+    json::field("rows", &packed_matrix_response::rows),
+    json::field("columns", &packed_matrix_response::columns),
+    json::field("encoding", &packed_matrix_response::encoding),
+    json::field("durations", &packed_matrix_response::durations),
+    json::field("distances", &packed_matrix_response::distances));
+}
+
+/**
+ * Computes the travel durations, and optionally distances, from every 
+ * source to every destination in one call, using the OSRM table service.
+ * 
+ * Params are "sources" and "destinations", arrays of coordinates within
+ * one region, together at most routing.max_matrix_locations of them.
+ * With "durations_only" distances are not computed, and "encoding" picks
+ * either the "json" (default) or the compact "base64" response shape.
+ */
+class distance_matrix_service final 
+  : public rpc::service_base
+{
+public:
+  distance_matrix_service(
+    routing::config const& config,
+    spacial::index const& index,
+    std::vector<import::region_paths> const& sources);
+
+public:
+  rpc::result_t invoke(
+    rpc::params_t const& params, 
+    rpc::context ctx) const override;
+
+  rpc::workload profile() const override
+  { return rpc::workload::compute; }
+
+  bool idempotent() const override { return true; }
+
+  size_t cost(rpc::params_t const& params) const override;
+
+  std::string partition(rpc::params_t const& params) const override;
 
 private:
   spacial::index const& index_;
+  size_t max_locations_;
   routing::osrm_map instancesmap_;
 };
 
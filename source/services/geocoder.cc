@@ -6,83 +6,83 @@
 #include "geocoder/geocoder.h"
 #include "geocoder/sqlite_fts/sqlite_fts.h"
 #include "utils/log.h"
+#include "utils/json_decode.h"
 
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 
 namespace sentio::services
 {
 
-inline static void throw_if_missing(json_t const& json, const char* path)
+static geocoder_request::capture_mode 
+capture_mode_of(std::optional<std::string> const& mode)
 {
-  if (!json.get_child_optional(path).has_value()) {
-    std::string message = "missing request param ";
-    throw std::invalid_argument(message + path);
+  if (mode.has_value() && boost::iequals(mode.value(), "camera")) {
+    return geocoder_request::capture_mode::camera;
   }
+  return geocoder_request::capture_mode::text;
 }
 
-geocoder_request::geocoder_request(json_t json)
-  : json_(std::move(json)) 
+static geocoder::address_components 
+components_of(rpc::params_t const& params)
+{
+  geocoder::address_components output;
+  if (auto c = json::find(params, "components"); c != nullptr) {
+    output.city = json::optional_string(*c, "city");
+    output.street = json::optional_string(*c, "street");
+    output.building = json::optional_string(*c, "building");
+    output.zipcode = json::optional_string(*c, "zipcode");
+  }
+  return output;
+}
+
+geocoder_request::geocoder_request(rpc::params_t const& params)
+  : text_(json::to_string(json::at(params, "text")))
+  , mode_(capture_mode_of(json::optional_string(params, "mode")))
+  , location_(boost::json::value_to<spacial::coordinates>(
+      json::at(params, "location")))
+  , overrides_(components_of(params))
 {
-  throw_if_missing(json_, "text");
-  throw_if_missing(json_, "location.latitude");
-  throw_if_missing(json_, "location.longitude");
 }
 
 std::string geocoder_request::text() const 
-{ return json_.get<std::string>("text"); }
+{ return text_; }
 
 geocoder_request::capture_mode geocoder_request::mode() const
-{
-  if (auto m = json_.get_optional<std::string>("mode"); m.has_value()) {
-    if (boost::iequals(m.value(), "camera")) {
-      return capture_mode::camera;
-    }
-    if (boost::iequals(m.value(), "text")) {
-      return capture_mode::text;
-    }
-  }
-  return capture_mode::text;
-}
+{ return mode_; }
 
 spacial::coordinates geocoder_request::location() const 
-{
-  return spacial::coordinates(
-    json_.get<double>("location.latitude"),
-    json_.get<double>("location.longitude"));
-}
+{ return location_; }
 
 geocoder::address_components geocoder_request::overrides() const
-{
-  geocoder::address_components output;
-
-  auto set_if_present = [this](const char* path) {
-    if (auto val = json_.get_optional<std::string>(path); val.has_value()) {
-      return std::optional<std::string>(val.value());
-    } else {
-      return std::optional<std::string>();
-    }
-  };
-
-  output.city = set_if_present("components.city");
-  output.street = set_if_present("components.street");
-  output.building = set_if_present("components.building");
-  output.zipcode = set_if_present("components.zipcode");
+{ return overrides_; }
 
-  return output;
+/**
+ * Hints without any known component carry no information for the user.
+ */
+static std::vector<geocoder::address_components> 
+drop_empty_hints(std::vector<geocoder::address_components> hints)
+{
+  hints.erase(std::remove_if(hints.begin(), hints.end(), 
+    [](auto const& hint) {
+      return !hint.city.has_value() && !hint.street.has_value() &&
+             !hint.building.has_value() && !hint.zipcode.has_value();
+    }), hints.end());
+  return hints;
 }
 
 geocoder_response::geocoder_response(
   std::vector<model::building> matches,
   std::vector<geocoder::address_components> hints)
   : matches_(std::move(matches))
-  , hints_(std::move(hints))
+  , hints_(drop_empty_hints(std::move(hints)))
 {
 }
 
 geocoder_response::geocoder_response(
   geocoder::lookup_result result)
   : matches_(std::move(result.matches))
-  , hints_(std::move(result.hints))
+  , hints_(drop_empty_hints(std::move(result.hints)))
 {
 }
 
@@ -94,43 +94,6 @@ std::vector<geocoder::address_components> const&
 geocoder_response::hints() const
 { return hints_; }
 
-json_t geocoder_response::to_json() const
-{
-  json_t output, hints, matches;
-  for (auto const& match: matches_) {
-    matches.push_back(std::make_pair("", match.to_json()));
-  }
-
-  for (auto const& hint: hints_) {
-    json_t hintobj;
-    if (hint.city.has_value()) {
-      hintobj.add("city", hint.city.value());
-    }
-    if (hint.street.has_value()) {
-      hintobj.add("street", hint.street.value());
-    }
-    if (hint.building.has_value()) {
-      hintobj.add("building", hint.building.value());
-    }
-    if (hint.zipcode.has_value()) {
-      hintobj.add("zipcode", hint.zipcode.value());
-    }
-    if (hintobj.size() != 0) {
-      hints.push_back(std::make_pair("", std::move(hintobj)));
-    }
-  }
-
-  if (matches.size() != 0) {
-    output.add_child("matches", std::move(matches));
-  }
-
-  if (hints.size() != 0) {
-    output.add_child("hints", std::move(hints));
-  }
-
-  return output;
-}
-
 static geocoder::geocoder create_backend(
   std::string const& mode,
   spacial::index const& worldix, 
@@ -152,12 +115,11 @@ geocoder_service::geocoder_service(
 {
 }
 
-json_t geocoder_service::invoke(json_t params, rpc::context) const
+rpc::result_t geocoder_service::invoke(rpc::params_t const& params, rpc::context) const
 {
-  geocoder_request request(std::move(params));
-  geocoder_response response(engine_.lookup(
+  geocoder_request request(params);
+  return geocoder_response(engine_.lookup(
     request.location(), request.text(), request.overrides()));
-  return response.to_json();
 }
 
 }
\ No newline at end of file
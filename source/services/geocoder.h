@@ -38,7 +38,7 @@ public:
   };
 
 public:
-  geocoder_request(json_t json);
+  geocoder_request(rpc::params_t const& params);
 
 public:
   /**
@@ -78,7 +78,10 @@ public:
   geocoder::address_components overrides() const;
 
 private:
-  json_t json_;
+  std::string text_;
+  capture_mode mode_;
+  spacial::coordinates location_;
+  geocoder::address_components overrides_;
 };
 
 /**
@@ -109,18 +112,22 @@ public:
    */
   std::vector<geocoder::address_components> const& hints() const;
 
-public:
-  /**
-   * Serializes the collection of matches and suggestions into an output
-   * json object that is returned to the caller over the wire.
-   */
-  json_t to_json() const;
-
 private:
   std::vector<model::building> matches_;
   std::vector<geocoder::address_components> hints_;
 };
 
+/**
+ * This is the JSON object returned to the caller over the wire,
+ * empty collections are left out.
+ */
+constexpr auto json_fields(geocoder_response const*)
+{
+  return std::make_tuple(
+    json::nonempty_field("matches", &geocoder_response::matches),
+    json::nonempty_field("hints", &geocoder_response::hints));
+}
+
 /**
  * This is the front-facing RPC service that invokes the geocoder
  * logic inside the geocoder/ code directory.
@@ -143,7 +150,14 @@ public:
    * This method will invoke logic implemented under /geocoder/ to
    * serve responses to end users.
    */
-  json_t invoke(json_t params, rpc::context) const override;
+  rpc::result_t invoke(rpc::params_t const& params, rpc::context) const override;
+
+  /**
+   * Decomposing an address runs the NER model and the lookup runs a full
+   * text search query, neither belongs on a network thread.
+   */
+  rpc::workload profile() const override
+  { return rpc::workload::compute; }
 
 private:
   geocoder::geocoder engine_;
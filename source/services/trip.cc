@@ -17,8 +17,10 @@
 #include "routing/trip.h"
 #include "utils/log.h"
 #include "utils/aws.h"
+#include "utils/aws_async.h"
 #include "utils/datetime.h"
 #include "spacial/coords.h"
+#include "utils/json_decode.h"
 
 namespace sentio::services
 {
@@ -39,24 +41,59 @@ static std::string random_string(size_t len)
   return output;
 }
 
-json_t trip_service::poll::invoke(json_t params, rpc::context ctx) const 
-{ 
-  using namespace Aws::DynamoDB::Model;
-  boost::ignore_unused(ctx);
+/**
+ * Decodes a trip submitted by a client. Its metadata is filled in 
+ * by the server, trips are assigned to the region of the location
+ * where they were created.
+ */
+static routing::trip_request decode_trip_request(
+  rpc::params_t const& params, 
+  rpc::context const& ctx,
+  spacial::index const& locator,
+  std::optional<std::string> id = {})
+{
+  try {
+    auto location = boost::json::value_to<spacial::coordinates>(
+      json::at(params, "location"));
+    auto region = locator.locate(location);
+    if (!region.has_value()) {
+      throw std::invalid_argument("region not found");
+    }
 
-  Aws::DynamoDB::DynamoDBClient dbclient;
-  auto tripid = params.get_optional<std::string>("tripid");
-  if (!tripid.has_value() || tripid.value().empty()) {
-    throw rpc::bad_request("missing parameter");
+    return routing::trip_request(
+      boost::json::value_to<routing::unoptimized_trip>(params),
+      routing::trip_metadata(
+        region->name(), ctx.uid,
+        boost::posix_time::second_clock::universal_time(),
+        std::move(id)),
+      std::move(location));
+  } catch (std::exception const& e) {
+    errlog << "trip parsing failed: " << e.what();
+    throw rpc::bad_request(e.what());
   }
+}
 
-  GetItemRequest girequest;
-  girequest.SetTableName(aws::resources().tables.trips);
-  girequest.AddKey("id", AttributeValue(tripid.value()));
-  auto giresponse = dbclient.GetItem(girequest);
+/**
+ * Trips are polled often by many clients, all calls share one client 
+ * and with it the pool of connections to DynamoDB.
+ */
+static Aws::DynamoDB::DynamoDBClient const& dynamodb()
+{
+  static Aws::DynamoDB::DynamoDBClient client(aws::client_config());
+  return client;
+}
 
+/**
+ * Builds the response to trip.poll out of the
+ * trip record stored in DynamoDB, if any.
+ */
+static rpc::result_t poll_result(
+  std::string const& tripid,
+  rpc::context const& ctx,
+  Aws::DynamoDB::Model::GetItemOutcome const& giresponse)
+{
   if (!giresponse.IsSuccess()) {
-    errlog << "trip.poll failed for tripid " << tripid.value() 
+    errlog << "trip.poll failed for tripid " << tripid 
               << " with error: " << giresponse.GetError().GetMessage()
              ;
     throw rpc::server_error();
@@ -66,20 +103,20 @@ json_t trip_service::poll::invoke(json_t params, rpc::context ctx) const
   // client that the route is not ready.
   if (giresponse.GetResult().GetItem().size() == 0) {
     json_t output;
-    output.add("id", tripid.value());
+    output.add("id", tripid);
     output.add("status", "pending");
     return output;
   }
 
   auto const& item = giresponse.GetResult().GetItem();
   if (item.find("accountid") == item.end()) {
-    errlog << "trip.poll failed for tripid " << tripid.value() 
+    errlog << "trip.poll failed for tripid " << tripid 
            << " because it doesn't have an accountid associated";
     throw rpc::server_error();
   }
 
   if (item.find("status") == item.end()) {
-    errlog << "trip.poll failed for tripid " << tripid.value() 
+    errlog << "trip.poll failed for tripid " << tripid 
            << " because it doesn't have a valid status value";
   }
 
@@ -114,26 +151,45 @@ json_t trip_service::poll::invoke(json_t params, rpc::context ctx) const
   }
 }
 
-// trip.async implementation
+rpc::result_t trip_service::poll::invoke(rpc::params_t const& params, rpc::context ctx) const 
+{
+  return rpc::block_on(invoke_async(params, std::move(ctx)));
+}
 
-json_t trip_service::async::invoke(json_t params, rpc::context ctx) const 
+boost::asio::awaitable<rpc::result_t> trip_service::poll::invoke_async(
+  rpc::params_t const& params, rpc::context ctx) const 
 { 
-  std::optional<routing::trip_request> request;
-  spacial::coordinates creation_location(
-    params.get_child("location"));
-  auto tripregion = locator().locate(creation_location);
+  using namespace Aws::DynamoDB::Model;
 
-  try {
-    params.add("meta.accountid", ctx.uid);
-    params.add("meta.create_at", current_iso_datetime_string());
-    params.add("meta.region", tripregion->name());
-    request.emplace(std::move(params));
-  } catch (std::exception const& e) {
-    throw rpc::bad_request(e.what());
+  auto tripid = json::optional_string(params, "tripid");
+  if (!tripid.has_value() || tripid.value().empty()) {
+    throw rpc::bad_request("missing parameter");
   }
 
-  if (request->trip().size() > config().max_waypoints) {
-    errlog << "trip request contains " << request->trip().size() 
+  GetItemRequest girequest;
+  girequest.SetTableName(aws::resources().tables.trips);
+  girequest.AddKey("id", AttributeValue(tripid.value()));
+  auto giresponse = co_await aws::async_call<GetItemOutcome>(
+    [&](auto const& done) { dynamodb().GetItemAsync(girequest, done); });
+
+  co_return poll_result(tripid.value(), ctx, giresponse);
+}
+
+// trip.async implementation
+
+rpc::result_t trip_service::async::invoke(rpc::params_t const& params, rpc::context ctx) const 
+{
+  return rpc::block_on(invoke_async(params, std::move(ctx)));
+}
+
+boost::asio::awaitable<rpc::result_t> trip_service::async::invoke_async(
+  rpc::params_t const& params, rpc::context ctx) const 
+{ 
+  auto request = decode_trip_request(params, ctx, locator());
+  auto tripregion = locator().locate(request.location());
+
+  if (request.trip().size() > config().max_waypoints) {
+    errlog << "trip request contains " << request.trip().size() 
               << " waypoints, configured maximum is "
               << config().max_waypoints << ". aborting.";
     throw std::invalid_argument("trip too large");
@@ -142,7 +198,7 @@ json_t trip_service::async::invoke(json_t params, rpc::context ctx) const
   // cross-regional routes are not supported yet.
   // reject all trips that have waypoints not belonging
   // to the region of the trip.
-  for (auto const& waypoint: request->trip()) {
+  for (auto const& waypoint: request.trip()) {
     if (locator().locate(waypoint.building.coords) != tripregion) {
       std::stringstream ss;
       boost::property_tree::write_json(ss, waypoint.to_json());
@@ -154,11 +210,11 @@ json_t trip_service::async::invoke(json_t params, rpc::context ctx) const
   }
 
   json_t output;
-  auto promise = scheduler().schedule_trip(std::move(*request));
+  auto promise = co_await scheduler().schedule_trip_async(std::move(request));
   output.add("trip.state", "pending");
   output.add("trip.mode", "asynchronous");
   output.add_child("trip.promise", promise.to_json());
-  return output; 
+  co_return output; 
 }
 
 trip_service::sync::sync(
@@ -170,26 +226,14 @@ trip_service::sync::sync(
 {
 }
 
-json_t trip_service::sync::invoke(json_t params, rpc::context ctx) const 
+rpc::result_t trip_service::sync::invoke(rpc::params_t const& params, rpc::context ctx) const 
 {
-  std::optional<routing::trip_request> request;
-  spacial::coordinates creation_location(
-    params.get_child("location"));
-  auto tripregion = locator().locate(creation_location);
-
-  try {
-    params.add("meta.id", "s_" + random_string(16));
-    params.add("meta.accountid", ctx.uid);
-    params.add("meta.createdat", current_iso_datetime_string());
-    params.add("meta.region", tripregion->name());
-    request.emplace(std::move(params));
-  } catch (std::exception const& e) {
-    errlog << "trip parsing failed: " << e.what();
-    throw rpc::bad_request(e.what());
-  }
+  auto request = decode_trip_request(
+    params, ctx, locator(), "s_" + random_string(16));
+  auto tripregion = locator().locate(request.location());
 
-  if (request->trip().size() > config().max_waypoints) {
-    errlog << "trip request contains " << request->trip().size() 
+  if (request.trip().size() > config().max_waypoints) {
+    errlog << "trip request contains " << request.trip().size() 
               << " waypoints, configured maximum is "
               << config().max_waypoints << ". aborting.";
     throw std::invalid_argument("trip too large");
@@ -198,7 +242,7 @@ json_t trip_service::sync::invoke(json_t params, rpc::context ctx) const
   // cross-regional routes are not supported yet.
   // reject all trips that have waypoints not belonging
   // to the region of the trip.
-  for (auto const& waypoint: request->trip()) {
+  for (auto const& waypoint: request.trip()) {
     if (locator().locate(waypoint.building.coords) != tripregion) {
       std::stringstream ss;
       boost::property_tree::write_json(ss, waypoint.to_json());
@@ -208,9 +252,8 @@ json_t trip_service::sync::invoke(json_t params, rpc::context ctx) const
       throw std::invalid_argument("waypoint not within region");
     }
   }
-  auto optimized = instancesmap_.optimize_trip(
-    request->trip(), request->meta().region());
-  return optimized.to_json();
+  return instancesmap_.optimize_trip(
+    request.trip(), request.meta().region());
 }
 
 }
\ No newline at end of file
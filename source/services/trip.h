@@ -11,6 +11,7 @@
 #include "routing/osrm_interop.h"
 #include "routing/scheduler.h"
 #include "spacial/index.h"
+#include "utils/json_decode.h"
 
 namespace sentio::services
 {
@@ -28,10 +29,33 @@ public:
 
 public:
   bool authenticated() const override { return true; }
-  json_t invoke(json_t params, rpc::context ctx) const override
+
+  size_t cost(rpc::params_t const& params) const override
+  {
+    // optimizing a trip grows with the number of waypoints,
+    // +2 accounts for the starting and final points.
+    if (auto wps = json::find(params, "waypoints"); wps && wps->is_array()) {
+      return wps->get_array().size() + 2;
+    }
+    return 1;
+  }
+
+  std::string partition(rpc::params_t const& params) const override
+  {
+    // trips are routed within the region of their creation location
+    if (auto location = json::find(params, "location"); location != nullptr) {
+      auto coords = boost::json::value_to<spacial::coordinates>(*location);
+      if (auto region = locator_.locate(coords)) {
+        return region->name();
+      }
+    }
+    return {};
+  }
+
+  rpc::result_t invoke(rpc::params_t const& params, rpc::context ctx) const override
   { 
     return dynamic_cast<const Impl*>(this)->invoke(
-      std::move(params), std::move(ctx)); 
+      params, std::move(ctx)); 
   }
 
 protected:
@@ -56,13 +80,21 @@ public:
   struct poll : public trip_service_base<poll>
   {
     using trip_service_base<poll>::trip_service_base;
-    json_t invoke(json_t params, rpc::context ctx) const;
+    rpc::result_t invoke(rpc::params_t const& params, rpc::context ctx) const;
+    boost::asio::awaitable<rpc::result_t> invoke_async(
+      rpc::params_t const& params, rpc::context ctx) const override;
+    rpc::workload profile() const override 
+    { return rpc::workload::async; }
   };
 
   struct async : public trip_service_base<async>
   {
     using trip_service_base<async>::trip_service_base;
-    json_t invoke(json_t params, rpc::context ctx) const;
+    rpc::result_t invoke(rpc::params_t const& params, rpc::context ctx) const;
+    boost::asio::awaitable<rpc::result_t> invoke_async(
+      rpc::params_t const& params, rpc::context ctx) const override;
+    rpc::workload profile() const override 
+    { return rpc::workload::async; }
   };
 
   struct sync : public trip_service_base<sync>
@@ -73,7 +105,10 @@ public:
       std::vector<import::region_paths> const& sources);
 
     using trip_service_base<sync>::trip_service_base;
-    json_t invoke(json_t params, rpc::context ctx) const;
+    rpc::result_t invoke(rpc::params_t const& params, rpc::context ctx) const;
+    rpc::workload profile() const override 
+    { return rpc::workload::compute; }
+    bool idempotent() const override { return true; }
 
   private:
     routing::osrm_map instancesmap_;
@@ -54,4 +54,21 @@ coordinates coordinates::from_json(json_t const& j)
     j.get<double>("longitude"));
 }
 
+json_t coordinates::to_json() const
+{
+  json_t output;
+  output.add("latitude", latitude());
+  output.add("longitude", longitude());
+  return output;
+}
+
+coordinates tag_invoke(
+  boost::json::value_to_tag<coordinates>, 
+  boost::json::value const& v)
+{
+  return coordinates(
+    json::to_double(json::at(v, "latitude")),
+    json::to_double(json::at(v, "longitude")));
+}
+
 }
\ No newline at end of file
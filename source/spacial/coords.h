@@ -9,6 +9,8 @@
 #include <boost/geometry.hpp>
 #include <boost/geometry/geometries/register/point.hpp>
 #include "utils/json.h"
+#include "utils/json_decode.h"
+#include "utils/json_encode.h"
 
 namespace sentio::spacial
 {
@@ -46,6 +48,23 @@ private:
   double lat_, lng_;
 };
 
+/**
+ * Decodes {"latitude": .., "longitude": ..} from a parsed request.
+ */
+coordinates tag_invoke(
+  boost::json::value_to_tag<coordinates>, 
+  boost::json::value const& v);
+
+/**
+ * Writes coordinates as {"latitude": .., "longitude": ..}.
+ */
+constexpr auto json_fields(coordinates const*)
+{
+  return std::make_tuple(
+    json::field("latitude", [](coordinates const& c) { return c.latitude(); }),
+    json::field("longitude", [](coordinates const& c) { return c.longitude(); }));
+}
+
 }
 
 /**
@@ -20,6 +20,11 @@
 
 namespace sentio::spacial
 {
+/**
+ * Reads the bounding polygon of the named region from a poly file.
+ */
+region::polygon to_polygon(std::string path, std::string name);
+
 /**
  * Locates a region in the world given a set of user coordinates.
  *
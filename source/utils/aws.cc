@@ -6,6 +6,7 @@
 #include <boost/algorithm/string.hpp>
 
 #include <aws/core/Aws.h>
+#include <aws/core/utils/threading/Executor.h>
 #include <aws/dynamodb/DynamoDBClient.h>
 
 #include "aws.h"
@@ -15,6 +16,7 @@ namespace sentio::aws
 {
 bool g_aws_initialized = false;
 std::optional<config> g_aws_config;
+std::shared_ptr<Aws::Utils::Threading::Executor> g_aws_executor;
 
 config::config(boost::property_tree::ptree const& json)
     : log_level(json.get<std::string>("log_level"))
@@ -22,6 +24,7 @@ config::config(boost::property_tree::ptree const& json)
              .accounts = json.get<std::string>("tables.accounts"),
              .locations = json.get<std::string>("tables.locations")}
     , queues{.pending_routes = json.get<std::string>("queues.pending_routes")}
+    , async_threads(json.get<size_t>("async_threads", 16))
 {
 }
 
@@ -51,6 +54,10 @@ void init(config cfg)
   options.httpOptions.installSigPipeHandler = true;
   Aws::InitAPI(options);
 
+  g_aws_executor = Aws::MakeShared<
+    Aws::Utils::Threading::PooledThreadExecutor>(
+      "trasa", cfg.async_threads);
+
   g_aws_config = g_aws_config.emplace(std::move(cfg));
   g_aws_initialized = true;
 }
@@ -63,6 +70,14 @@ config const& resources()
   return g_aws_config.value();
 }
 
+Aws::Client::ClientConfiguration client_config()
+{
+  Aws::Client::ClientConfiguration output;
+  output.executor = g_aws_executor;
+  output.maxConnections = resources().async_threads;
+  return output;
+}
+
 Aws::DynamoDB::Model::AttributeValue as_av(spacial::coordinates const& coords)
 {
   return Aws::DynamoDB::Model::AttributeValue()
@@ -8,6 +8,7 @@
 #include <boost/property_tree/ptree.hpp>
 
 #include <aws/core/client/AWSClient.h>
+#include <aws/core/client/ClientConfiguration.h>
 #include <aws/dynamodb/model/AttributeValue.h>
 #include <aws/dynamodb/model/AttributeDefinition.h>
 
@@ -37,6 +38,13 @@ struct config {
     std::string pending_routes;
   } queues;
 
+  /**
+   * Number of threads that run asynchronous SDK calls, and the
+   * number of connections each client keeps open to AWS. Calls
+   * issued beyond that wait in the executor queue.
+   */
+  size_t async_threads;
+
   config(boost::property_tree::ptree const& json);
 };
 
@@ -58,6 +66,13 @@ void init(config);
  */
 config const& resources();
 
+/**
+ * Configuration for AWS service clients whose asynchronous calls
+ * share one bounded pool of SDK threads, instead of the default 
+ * executor that starts a new thread for every call.
+ */
+Aws::Client::ClientConfiguration client_config();
+
 
 /**
  * Creates an AttributeValue shared pointer for use with
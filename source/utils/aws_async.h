@@ -0,0 +1,60 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <boost/asio/post.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/associated_executor.hpp>
+
+namespace sentio::aws
+{
+
+/**
+ * Bridges an asynchronous AWS SDK call into asio.
+ *
+ * @c start is invoked with a callback that must be passed as the
+ * completion handler of one of the SDK *Async methods, for example:
+ *
+ *   auto outcome = co_await aws::async_call<GetItemOutcome>(
+ *     [&](auto const& done) { client.GetItemAsync(request, done); });
+ *
+ * The SDK invokes the callback on one of its own threads, from where
+ * the outcome is posted back to the executor of the awaiting operation.
+ * The awaiting coroutine is suspended in the meantime and occupies no
+ * thread. The executor is kept busy until the call completes, so an
+ * io_context doesn't run out of work while calls are pending.
+ *
+ * The client and the request must outlive the call.
+ */
+template <
+  typename Outcome,
+  typename Start,
+  typename CompletionToken = boost::asio::use_awaitable_t<>>
+auto async_call(Start&& start, CompletionToken&& token = {})
+{
+  return boost::asio::async_initiate<CompletionToken, void(Outcome)>(
+    [start = std::forward<Start>(start)](auto handler) mutable {
+      auto work = boost::asio::make_work_guard(
+        boost::asio::get_associated_executor(handler));
+
+      // SDK callbacks are std::functions and have to be copyable,
+      // while asio handlers are move-only.
+      auto pending = std::make_shared<decltype(handler)>(std::move(handler));
+      start([pending, work](auto const*, auto const&,
+                            Outcome const& outcome, auto const&) mutable {
+        boost::asio::post(work.get_executor(),
+          [pending, outcome]() mutable {
+            (*pending)(std::move(outcome));
+          });
+        work.reset();
+      });
+    }, token);
+}
+
+}  // namespace sentio::aws
@@ -0,0 +1,172 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "json_decode.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <charconv>
+#include <stdexcept>
+#include <boost/json/parse.hpp>
+#include <boost/json/serialize.hpp>
+
+namespace sentio::json
+{
+
+namespace // detail
+{
+  [[noreturn]] void fail(const char* message, std::string_view key = {})
+  {
+    std::string text(message);
+    if (!key.empty()) {
+      text.append(": ").append(key);
+    }
+    throw std::invalid_argument(text);
+  }
+
+  int64_t parse_integer(std::string_view text)
+  {
+    int64_t output{};
+    auto [end, ec] = std::from_chars(
+      text.data(), text.data() + text.size(), output);
+    if (ec != std::errc() || end != text.data() + text.size()) {
+      fail("expected an integer");
+    }
+    return output;
+  }
+
+  /**
+   * libstdc++ 10, which we build with, has no floating point overloads
+   * of std::from_chars. The process never changes the C locale, so the
+   * decimal separator is always a dot.
+   */
+  double parse_double(std::string_view text)
+  {
+    std::string copy(text);
+    char* end = nullptr;
+    errno = 0;
+    double output = std::strtod(copy.c_str(), &end);
+    if (copy.empty() || errno == ERANGE || end != copy.c_str() + copy.size()) {
+      fail("expected a number");
+    }
+    return output;
+  }
+}
+
+value parse(std::string_view input)
+{
+  boost::json::error_code ec;
+  auto output = boost::json::parse(input, ec);
+  if (ec) {
+    fail("parse error");
+  }
+  return output;
+}
+
+value const& at(value const& v, std::string_view key)
+{
+  auto obj = v.if_object();
+  if (obj == nullptr) {
+    fail("expected an object with field", key);
+  }
+  auto field = obj->if_contains(key);
+  if (field == nullptr) {
+    fail("missing request param", key);
+  }
+  return *field;
+}
+
+value const* find(value const& v, std::string_view key)
+{
+  auto obj = v.if_object();
+  if (obj == nullptr) {
+    return nullptr;
+  }
+  auto field = obj->if_contains(key);
+  if (field == nullptr || field->is_null()) {
+    return nullptr;
+  }
+  return field;
+}
+
+double to_double(value const& v)
+{
+  switch (v.kind()) {
+    case boost::json::kind::double_: return v.get_double();
+    case boost::json::kind::int64: return static_cast<double>(v.get_int64());
+    case boost::json::kind::uint64: return static_cast<double>(v.get_uint64());
+    case boost::json::kind::string: {
+      auto const& s = v.get_string();
+      return parse_double(std::string_view(s.data(), s.size()));
+    }
+    default: fail("expected a number");
+  }
+}
+
+int64_t to_int64(value const& v)
+{
+  switch (v.kind()) {
+    case boost::json::kind::int64: return v.get_int64();
+    case boost::json::kind::uint64: return static_cast<int64_t>(v.get_uint64());
+    case boost::json::kind::string: {
+      auto const& s = v.get_string();
+      return parse_integer(std::string_view(s.data(), s.size()));
+    }
+    default: fail("expected an integer");
+  }
+}
+
+std::string to_string(value const& v)
+{
+  switch (v.kind()) {
+    case boost::json::kind::string:
+      return std::string(v.get_string().data(), v.get_string().size());
+    case boost::json::kind::int64: return std::to_string(v.get_int64());
+    case boost::json::kind::uint64: return std::to_string(v.get_uint64());
+    case boost::json::kind::double_: return boost::json::serialize(v);
+    default: fail("expected a string");
+  }
+}
+
+std::optional<std::string> optional_string(
+  value const& v, std::string_view key)
+{
+  if (auto field = find(v, key); field != nullptr) {
+    return to_string(*field);
+  }
+  return std::nullopt;
+}
+
+json_t to_ptree(value const& v)
+{
+  json_t output;
+  switch (v.kind()) {
+    case boost::json::kind::object:
+      for (auto const& field: v.get_object()) {
+        output.push_back(std::make_pair(
+          std::string(field.key()), to_ptree(field.value())));
+      }
+      break;
+    case boost::json::kind::array:
+      for (auto const& element: v.get_array()) {
+        output.push_back(std::make_pair("", to_ptree(element)));
+      }
+      break;
+    case boost::json::kind::string:
+      output.put_value(std::string(
+        v.get_string().data(), v.get_string().size()));
+      break;
+    case boost::json::kind::bool_:
+      output.put_value(v.get_bool() ? "true" : "false");
+      break;
+    case boost::json::kind::null:
+      break;
+    default: // numbers
+      output.put_value(to_string(v));
+      break;
+  }
+  return output;
+}
+
+}
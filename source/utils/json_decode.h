@@ -0,0 +1,79 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include <boost/json/value.hpp>
+#include <boost/json/value_to.hpp>
+
+#include "json.h"
+
+/**
+ * Incoming JSON-RPC requests are parsed with Boost.JSON and decoded
+ * straight into typed request structures, property_tree is only used
+ * for building responses.
+ *
+ * Types that can be decoded from a request provide an overload of
+ * tag_invoke(boost::json::value_to_tag<T>, boost::json::value const&)
+ * in their own namespace and are decoded with boost::json::value_to<T>.
+ * The helpers below report malformed input as std::invalid_argument,
+ * which is returned to clients as "invalid params".
+ */
+namespace sentio::json
+{
+
+using value = boost::json::value;
+using object = boost::json::object;
+using array = boost::json::array;
+
+/**
+ * Parses a JSON document, throws std::invalid_argument if the
+ * input is not valid JSON.
+ */
+value parse(std::string_view input);
+
+/**
+ * Returns the field of an object, throws if the
+ * value is not an object or the field is missing.
+ */
+value const& at(value const& v, std::string_view key);
+
+/**
+ * Returns the field of an object, or nullptr if the value
+ * is not an object, the field is missing or it is null.
+ */
+value const* find(value const& v, std::string_view key);
+
+/**
+ * Numbers are accepted both as JSON numbers and as numeric strings.
+ * property_tree writes every number as a string, so clients that echo
+ * back our own responses (waypoints, buildings) send them that way.
+ */
+double to_double(value const& v);
+int64_t to_int64(value const& v);
+
+/**
+ * Strings are taken as they are, numbers are formatted,
+ * anything else is rejected.
+ */
+std::string to_string(value const& v);
+
+/**
+ * The string value of an optional field, nullopt if missing or null.
+ */
+std::optional<std::string> optional_string(
+  value const& v, std::string_view key);
+
+/**
+ * Converts to the property tree representation, for the code paths
+ * that still consume json_t, like messages stored on SQS.
+ */
+json_t to_ptree(value const& v);
+
+}
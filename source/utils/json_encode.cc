@@ -0,0 +1,236 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "json_encode.h"
+
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+
+namespace sentio::json
+{
+
+namespace // detail
+{
+  /**
+   * Doubles keep 8 significant digits, this is the precision
+   * coordinates were always sent with (sub-meter accuracy).
+   */
+  constexpr int double_precision = 8;
+
+  std::string_view format_double(double value, char (&buffer)[32])
+  {
+#if defined(__cpp_lib_to_chars)
+    auto [end, ec] = std::to_chars(
+      buffer, buffer + sizeof(buffer), value,
+      std::chars_format::general, double_precision);
+    return std::string_view(buffer, ec == std::errc() ? end - buffer : 0);
+#else
+    // libstdc++ 10 has no floating point to_chars,
+    // this formats into the stack buffer just the same.
+    int size = std::snprintf(
+      buffer, sizeof(buffer), "%.*g", double_precision, value);
+    return std::string_view(buffer, size > 0 ? size : 0);
+#endif
+  }
+}
+
+writer::~writer()
+{ flush(); }
+
+void writer::flush()
+{
+  if (staged_ != 0) {
+    flush_(target_, staging_, staged_);
+    staged_ = 0;
+  }
+}
+
+void writer::put(char c)
+{
+  if (staged_ == staging_size) {
+    flush();
+  }
+  staging_[staged_++] = c;
+}
+
+void writer::put(std::string_view text)
+{
+  if (text.size() > staging_size - staged_) {
+    flush();
+    if (text.size() > staging_size) {
+      flush_(target_, text.data(), text.size());
+      return;
+    }
+  }
+  std::memcpy(staging_ + staged_, text.data(), text.size());
+  staged_ += text.size();
+}
+
+void writer::begin_value()
+{
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+
+  if (depth_ != 0) {
+    uint64_t bit = uint64_t(1) << (depth_ - 1);
+    if (nonempty_ & bit) {
+      put(',');
+    }
+    nonempty_ |= bit;
+  }
+}
+
+void writer::begin_object()
+{
+  begin_value();
+  if (depth_ == max_depth) {
+    throw std::length_error("json nested too deep");
+  }
+  put('{');
+  nonempty_ &= ~(uint64_t(1) << depth_++);
+}
+
+void writer::end_object()
+{
+  put('}');
+  --depth_;
+}
+
+void writer::begin_array()
+{
+  begin_value();
+  if (depth_ == max_depth) {
+    throw std::length_error("json nested too deep");
+  }
+  put('[');
+  nonempty_ &= ~(uint64_t(1) << depth_++);
+}
+
+void writer::end_array()
+{
+  put(']');
+  --depth_;
+}
+
+void writer::key(std::string_view name)
+{
+  string(name);
+  put(':');
+  after_key_ = true;
+}
+
+void writer::string(std::string_view value)
+{
+  static constexpr char hex[] = "0123456789abcdef";
+
+  begin_value();
+  put('"');
+
+  // copy runs of characters that need no escaping in one go
+  size_t run = 0;
+  for (size_t i = 0; i < value.size(); ++i) {
+    auto c = static_cast<unsigned char>(value[i]);
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+
+    put(value.substr(run, i - run));
+    run = i + 1;
+    switch (c) {
+      case '"': put("\\\""); break;
+      case '\\': put("\\\\"); break;
+      case '\n': put("\\n"); break;
+      case '\r': put("\\r"); break;
+      case '\t': put("\\t"); break;
+      case '\b': put("\\b"); break;
+      case '\f': put("\\f"); break;
+      default: {
+        char escaped[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+        put(std::string_view(escaped, sizeof(escaped)));
+      }
+    }
+  }
+  put(value.substr(run));
+  put('"');
+}
+
+void writer::put_number(std::string_view digits)
+{
+  begin_value();
+  if (format_ == numbers::quoted) {
+    put('"');
+    put(digits);
+    put('"');
+  } else {
+    put(digits);
+  }
+}
+
+void writer::number(int64_t value)
+{
+  char buffer[24];
+  auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  put_number(std::string_view(buffer, end - buffer));
+}
+
+void writer::number(uint64_t value)
+{
+  char buffer[24];
+  auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+  put_number(std::string_view(buffer, end - buffer));
+}
+
+void writer::number(double value)
+{
+  char buffer[32];
+  put_number(format_double(value, buffer));
+}
+
+void writer::boolean(bool value)
+{
+  begin_value();
+  put(value ? "true" : "false");
+}
+
+void writer::null()
+{
+  begin_value();
+  put("null");
+}
+
+void writer::raw(std::string_view json)
+{
+  begin_value();
+  put(json);
+}
+
+void write(writer& w, json_t const& tree)
+{
+  if (tree.empty()) {
+    w.string(tree.data());
+    return;
+  }
+
+  bool array = tree.count(std::string()) == tree.size();
+  if (array) {
+    w.begin_array();
+    for (auto const& child: tree) {
+      write(w, child.second);
+    }
+    w.end_array();
+  } else {
+    w.begin_object();
+    for (auto const& child: tree) {
+      w.key(child.first);
+      write(w, child.second);
+    }
+    w.end_object();
+  }
+}
+
+}
@@ -0,0 +1,262 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <tuple>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+
+#include <boost/asio/buffer.hpp>
+
+#include "json.h"
+
+/**
+ * Responses are written as JSON text directly into the outgoing network
+ * buffer, without building a property tree or an intermediate string.
+ *
+ * Model types describe their JSON representation with a constexpr tuple
+ * of fields returned by a json_fields(T const*) function declared next to
+ * the type, found through ADL:
+ *
+ *   constexpr auto json_fields(building const*) {
+ *     return std::make_tuple(
+ *       json::field("id", &building::id),
+ *       json::field("city", &building::city));
+ *   }
+ *
+ * Accessors are anything std::invoke can call with the object: data
+ * members, const member functions or lambdas. The serializer expands
+ * the tuple at compile time, so writing a described type costs the
+ * same as hand written writer calls.
+ */
+namespace sentio::json
+{
+
+/**
+ * Streams JSON tokens into a dynamic buffer.
+ *
+ * Output is staged in a small fixed buffer inside the writer and copied
+ * into the target in chunks, so writing a token is a couple of stores and
+ * the target grows at most once per chunk. The writer inserts commas and
+ * colons itself, callers only emit keys and values in order.
+ */
+class writer
+{
+public:
+  /**
+   * Responses were produced by property_tree for a long time, which
+   * writes every value as a string. Clients depend on that, so numbers
+   * are written as strings unless the writer is told otherwise.
+   */
+  enum class numbers { quoted, plain };
+
+public:
+  template <typename DynamicBuffer>
+  explicit writer(DynamicBuffer& target, numbers format = numbers::quoted)
+    : target_(&target)
+    , flush_(&flush_into<DynamicBuffer>)
+    , format_(format) {}
+
+  ~writer();
+
+public: // noncopyable
+  writer(writer const&) = delete;
+  writer& operator=(writer const&) = delete;
+
+public:
+  void begin_object();
+  void end_object();
+  void begin_array();
+  void end_array();
+
+  void key(std::string_view name);
+
+  void string(std::string_view value);
+  void number(int64_t value);
+  void number(uint64_t value);
+  void number(double value);
+  void boolean(bool value);
+  void null();
+
+  /**
+   * Inserts text that is already valid JSON, as a value.
+   */
+  void raw(std::string_view json);
+
+  /**
+   * Copies everything staged so far into the target buffer.
+   */
+  void flush();
+
+private:
+  void begin_value();
+  void put(char c);
+  void put(std::string_view text);
+  void put_number(std::string_view digits);
+
+  template <typename DynamicBuffer>
+  static void flush_into(void* target, const char* data, size_t size)
+  {
+    auto& buffer = *static_cast<DynamicBuffer*>(target);
+    buffer.commit(boost::asio::buffer_copy(
+      buffer.prepare(size), boost::asio::buffer(data, size)));
+  }
+
+private:
+  static constexpr size_t max_depth = 64;
+  static constexpr size_t staging_size = 2048;
+
+  void* target_;
+  void (*flush_)(void*, const char*, size_t);
+  numbers format_;
+
+  size_t depth_ = 0;
+  uint64_t nonempty_ = 0;  // one bit per open object/array
+  bool after_key_ = false;
+
+  size_t staged_ = 0;
+  char staging_[staging_size];
+};
+
+/**
+ * Describes one field of a type, @c access is invoked with the object
+ * to get the value. With @c omit_empty set, the field is left out when
+ * its value is an empty string or range, or an optional holding one.
+ * Optionals without a value are always left out.
+ */
+template <typename Accessor>
+struct field_descriptor
+{
+  std::string_view name;
+  Accessor access;
+  bool omit_empty;
+};
+
+template <typename Accessor>
+constexpr auto field(std::string_view name, Accessor access)
+{ return field_descriptor<Accessor>{name, access, false}; }
+
+template <typename Accessor>
+constexpr auto nonempty_field(std::string_view name, Accessor access)
+{ return field_descriptor<Accessor>{name, access, true}; }
+
+namespace detail
+{
+  template <typename T>
+  struct is_optional : std::false_type {};
+
+  template <typename T>
+  struct is_optional<std::optional<T>> : std::true_type {};
+
+  template <typename T>
+  concept string_like = std::is_convertible_v<T const&, std::string_view>;
+
+  template <typename T>
+  concept range = !string_like<T> && !std::is_same_v<T, json_t> &&
+    requires(T const& r) { r.begin(); r.end(); r.empty(); };
+
+  template <typename T>
+  concept described = requires(T const* t) { json_fields(t); };
+
+  template <typename T>
+  bool is_empty(T const& value)
+  {
+    if constexpr (is_optional<T>::value) {
+      return !value.has_value() || is_empty(value.value());
+    } else if constexpr (string_like<T>) {
+      return std::string_view(value).empty();
+    } else if constexpr (range<T>) {
+      return value.empty();
+    } else {
+      return false;
+    }
+  }
+}
+
+/**
+ * Property trees are written the way write_json writes them: leaves
+ * as strings, nodes whose children all have empty names as arrays.
+ */
+void write(writer& w, json_t const& tree);
+
+inline void write(writer& w, std::string_view value)
+{ w.string(value); }
+
+inline void write(writer& w, std::string const& value)
+{ w.string(value); }
+
+inline void write(writer& w, const char* value)
+{ w.string(value); }
+
+inline void write(writer& w, bool value)
+{ w.boolean(value); }
+
+inline void write(writer& w, double value)
+{ w.number(value); }
+
+template <typename T> requires std::is_integral_v<T>
+void write(writer& w, T value)
+{
+  if constexpr (std::is_signed_v<T>) {
+    w.number(static_cast<int64_t>(value));
+  } else {
+    w.number(static_cast<uint64_t>(value));
+  }
+}
+
+template <typename Rep, typename Period>
+void write(writer& w, std::chrono::duration<Rep, Period> value)
+{ write(w, value.count()); }
+
+template <typename T>
+void write(writer& w, std::optional<T> const& value)
+{
+  if (value.has_value()) {
+    write(w, value.value());
+  } else {
+    w.null();
+  }
+}
+
+template <detail::range Range>
+void write(writer& w, Range const& values)
+{
+  w.begin_array();
+  for (auto const& value: values) {
+    write(w, value);
+  }
+  w.end_array();
+}
+
+template <detail::described T>
+void write(writer& w, T const& object)
+{
+  w.begin_object();
+  std::apply([&](auto const&... fields) {
+    auto write_field = [&](auto const& f) {
+      decltype(auto) value = std::invoke(f.access, object);
+      using value_type = std::decay_t<decltype(value)>;
+      if constexpr (detail::is_optional<value_type>::value) {
+        if (!value.has_value()) {
+          return;
+        }
+      }
+      if (f.omit_empty && detail::is_empty(value)) {
+        return;
+      }
+      w.key(f.name);
+      write(w, value);
+    };
+    (write_field(fields), ...);
+  }, json_fields(static_cast<T const*>(nullptr)));
+  w.end_object();
+}
+
+}
@@ -4,9 +4,14 @@
 
 #include "log.h"
 #include "json.h"
+#include "metrics.h"
+#include "ring_buffer.h"
 
 #include <atomic>
+#include <thread>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
 #include <functional>
 
 #include <boost/ref.hpp>
@@ -19,7 +24,6 @@
 #include <boost/log/attributes.hpp>
 #include <boost/log/sinks.hpp>
 #include <boost/log/sources/logger.hpp>
-#include <boost/log/utility/record_ordering.hpp>
 
 namespace sentio::logging
 {
@@ -72,37 +76,97 @@ void coloring_formatter(
   }
 }
 
-void init(json_t const&)
+namespace // detail
 {
-  typedef sinks::text_ostream_backend backend_t;
-    typedef sinks::asynchronous_sink<
-      backend_t,
-      sinks::bounded_ordering_queue<
-          logging::attribute_value_ordering<unsigned int, std::less<unsigned int>>,
-          128,                        // queue no more than 128 log records
-          sinks::block_on_overflow    // wait until records are processed
-      >
-    > sink_t;
+  /**
+   * Formats records on the threads that log them and hands them over
+   * to a writer thread through a lock-free ring. When the writer falls
+   * behind and the ring fills up, records are dropped and counted
+   * rather than stalling request threads.
+   */
+  class ring_backend 
+    : public sinks::basic_sink_backend<sinks::concurrent_feeding>
+  {
+  public:
+    ring_backend(size_t capacity, boost::shared_ptr<std::ostream> stream)
+      : ring_(capacity)
+      , stream_(std::move(stream))
+      , dropped_(metrics::registry::instance().add_counter(
+          "log_dropped_records_total", 
+          "Log records dropped because the log queue was full"))
+      , writer_([this]() { drain(); })
+    {
+    }
+
+    ~ring_backend()
+    {
+      stopping_ = true;
+      writer_.join();
+    }
+
+  public:
+    void consume(logging::record_view const& rec)
+    {
+      std::string text;
+      {
+        logging::formatting_ostream strm(text);
+        coloring_formatter(rec, strm);
+        strm << '\n';
+      }
+      if (!ring_.try_push(std::move(text))) {
+        dropped_.add();
+      }
+    }
+
+  private:
+    void drain()
+    {
+      std::string text;
+      while (true) {
+        if (ring_.try_pop(text)) {
+          *stream_ << text;
+          continue;
+        }
+        stream_->flush();
+        if (stopping_) {
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+
+  private:
+    utils::ring_buffer<std::string> ring_;
+    boost::shared_ptr<std::ostream> stream_;
+    metrics::counter& dropped_;
+    std::atomic<bool> stopping_{false};
+    std::thread writer_;
+  };
+}
+
+void init(json_t const& config)
+{
+  auto levelname = config.get<std::string>("level", "info");
+  severity level;
+  if (!logging::trivial::from_string(
+        levelname.data(), levelname.size(), level)) {
+    throw std::invalid_argument("unknown log level: " + levelname);
+  }
 
   boost::shared_ptr<std::ostream> strm(
     &std::cout, boost::null_deleter());
 
-  boost::shared_ptr<sink_t> sink(new sink_t(
-    boost::make_shared<backend_t>(),
-    keywords::order = logging::make_attr_ordering(
-      "#", std::less<unsigned int>())));
-
-  sink->locked_backend()
-      ->add_stream(strm);
-  sink->set_formatter(&coloring_formatter);
+  auto sink = boost::make_shared<sinks::unlocked_sink<ring_backend>>(
+    boost::make_shared<ring_backend>(
+      config.get<size_t>("queue_size", 8192), strm));
 
   // Add it to the core
   logging::core::get()->add_sink(sink);
-  logging::core::get()->set_filter(logging::trivial::severity >= logging::trivial::trace);
+  logging::core::get()->set_filter(logging::trivial::severity >= level);
+  runtime_level.store(level, std::memory_order_relaxed);
   
   // Add some attributes too
   logging::core::get()->add_global_attribute("ts", attrs::local_clock());
-  logging::core::get()->add_global_attribute("#", attrs::counter<unsigned int>());
 }
 
 }
\ No newline at end of file
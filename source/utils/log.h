@@ -6,18 +6,53 @@
 
 #include "json.h"
 
+#include <atomic>
 #include <boost/log/trivial.hpp>
 #include <boost/log/attributes/scoped_attribute.hpp>
 
-#define tracelog BOOST_LOG_TRIVIAL(trace)
-#define dbglog BOOST_LOG_TRIVIAL(debug)
-#define infolog BOOST_LOG_TRIVIAL(info)
-#define warnlog BOOST_LOG_TRIVIAL(warning)
-#define errlog BOOST_LOG_TRIVIAL(error)
-#define fatallog BOOST_LOG_TRIVIAL(fatal)
+/**
+ * Log statements below this severity are compiled out, 0 is trace and
+ * 5 is fatal. Set through the TRASA_MIN_LOG_LEVEL cmake cache variable.
+ */
+#ifndef TRASA_MIN_LOG_LEVEL
+#define TRASA_MIN_LOG_LEVEL 0
+#endif
+
+/**
+ * Opens a log record only if its severity is enabled, otherwise none of
+ * the streamed arguments are evaluated. Statements below the compiled
+ * level are a constant false branch that the compiler removes.
+ */
+#define SENTIO_LOG(lvl)                                                   \
+  if (!::sentio::logging::enabled(::boost::log::trivial::lvl)) {}         \
+  else BOOST_LOG_TRIVIAL(lvl)
+
+#define tracelog SENTIO_LOG(trace)
+#define dbglog SENTIO_LOG(debug)
+#define infolog SENTIO_LOG(info)
+#define warnlog SENTIO_LOG(warning)
+#define errlog SENTIO_LOG(error)
+#define fatallog SENTIO_LOG(fatal)
 
 namespace sentio::logging
 {
+  using severity = boost::log::trivial::severity_level;
+
+  constexpr severity compiled_level = 
+    static_cast<severity>(TRASA_MIN_LOG_LEVEL);
+
+  /**
+   * The lowest severity logged at runtime, as configured
+   * by logging.level. Everything is logged until init runs.
+   */
+  inline std::atomic<severity> runtime_level{severity::trace};
+
+  inline bool enabled(severity level)
+  {
+    return level >= compiled_level && 
+           level >= runtime_level.load(std::memory_order_relaxed);
+  }
+
   size_t assign_thread_id();
   void init(json_t const& config);
-}
\ No newline at end of file
+}
@@ -0,0 +1,289 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "metrics.h"
+
+#include <bit>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+namespace sentio::metrics
+{
+
+namespace detail
+{
+  size_t thread_slot()
+  {
+    static std::atomic<size_t> next{0};
+    thread_local size_t slot = next.fetch_add(1) % shard_count;
+    return slot;
+  }
+}
+
+namespace // detail
+{
+  /**
+   * Upper bounds of the buckets exposed to Prometheus, in seconds.
+   */
+  constexpr double exported_bounds[] = {
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+    0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0
+  };
+
+  void escape_label(std::ostream& os, std::string const& value)
+  {
+    for (char c: value) {
+      switch (c) {
+        case '\\': os << "\\\\"; break;
+        case '"': os << "\\\""; break;
+        case '\n': os << "\\n"; break;
+        default: os << c;
+      }
+    }
+  }
+
+  /**
+   * Writes {name="value",...}, with an optional extra
+   * label used for histogram bucket bounds.
+   */
+  void write_labels(
+    std::ostream& os, labels const& labels,
+    const char* extra_name = nullptr,
+    std::string const& extra_value = {})
+  {
+    if (labels.empty() && extra_name == nullptr) {
+      return;
+    }
+
+    os << '{';
+    bool first = true;
+    for (auto const& [name, value]: labels) {
+      os << (first ? "" : ",") << name << "=\"";
+      escape_label(os, value);
+      os << '"';
+      first = false;
+    }
+    if (extra_name != nullptr) {
+      os << (first ? "" : ",") << extra_name << "=\"" << extra_value << '"';
+    }
+    os << '}';
+  }
+
+  void write_histogram(
+    std::ostream& os, std::string const& name,
+    labels const& labels, histogram const& h)
+  {
+    auto snapshot = h.read();
+
+    // fine buckets are folded into the exported bucket that covers
+    // their upper bound, so bucket boundaries are exact to within
+    // the precision of the fine buckets.
+    size_t fine = 0;
+    uint64_t cumulative = 0;
+    for (double bound: exported_bounds) {
+      auto bound_us = static_cast<uint64_t>(bound * 1e6);
+      while (fine < histogram::bucket_count &&
+             histogram::upper_bound(fine) <= bound_us + 1) {
+        cumulative += snapshot.buckets[fine++];
+      }
+      std::ostringstream le;
+      le << bound;
+      os << name << "_bucket";
+      write_labels(os, labels, "le", le.str());
+      os << ' ' << cumulative << '\n';
+    }
+
+    os << name << "_bucket";
+    write_labels(os, labels, "le", "+Inf");
+    os << ' ' << snapshot.count << '\n';
+
+    os << name << "_sum";
+    write_labels(os, labels);
+    os << ' ' << static_cast<double>(snapshot.sum) / 1e6 << '\n';
+
+    os << name << "_count";
+    write_labels(os, labels);
+    os << ' ' << snapshot.count << '\n';
+  }
+}
+
+uint64_t counter::value() const
+{
+  uint64_t total = 0;
+  for (auto const& shard: shards_) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+int64_t gauge::value() const
+{
+  int64_t total = 0;
+  for (auto const& shard: shards_) {
+    total += shard.value.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+size_t histogram::bucket_of(uint64_t value)
+{
+  constexpr uint64_t sub_buckets = uint64_t(1) << sub_bucket_bits;
+  if (value < sub_buckets) {
+    return value;
+  }
+
+  size_t exponent = std::bit_width(value) - 1;
+  if (exponent >= max_value_bits) {
+    return bucket_count - 1;
+  }
+
+  size_t sub = (value >> (exponent - sub_bucket_bits)) & (sub_buckets - 1);
+  return ((exponent - sub_bucket_bits + 1) << sub_bucket_bits) + sub;
+}
+
+uint64_t histogram::upper_bound(size_t bucket)
+{
+  constexpr uint64_t sub_buckets = uint64_t(1) << sub_bucket_bits;
+  if (bucket < sub_buckets) {
+    return bucket + 1;
+  }
+
+  size_t exponent = (bucket >> sub_bucket_bits) + sub_bucket_bits - 1;
+  uint64_t sub = bucket & (sub_buckets - 1);
+  return (sub_buckets + sub + 1) << (exponent - sub_bucket_bits);
+}
+
+void histogram::record(std::chrono::microseconds elapsed)
+{
+  auto value = static_cast<uint64_t>(std::max<int64_t>(0, elapsed.count()));
+  auto& shard = shards_[detail::thread_slot()];
+  shard.buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+histogram::snapshot histogram::read() const
+{
+  snapshot output{};
+  for (auto const& shard: shards_) {
+    for (size_t i = 0; i < bucket_count; ++i) {
+      auto count = shard.buckets[i].load(std::memory_order_relaxed);
+      output.buckets[i] += count;
+      output.count += count;
+    }
+    output.sum += shard.sum.load(std::memory_order_relaxed);
+  }
+  return output;
+}
+
+registry& registry::instance()
+{
+  static registry metrics;
+  return metrics;
+}
+
+registry::series& registry::find_or_add(
+  std::string const& name,
+  std::string const& help,
+  std::string const& type,
+  labels const& labels)
+{
+  auto& fam = families_[name];
+  if (fam.type.empty()) {
+    fam.help = help;
+    fam.type = type;
+  } else if (fam.type != type) {
+    throw std::invalid_argument(
+      "metric " + name + " already registered as " + fam.type);
+  }
+
+  for (auto& s: fam.series) {
+    if (s->labels == labels) {
+      return *s;
+    }
+  }
+
+  fam.series.emplace_back(std::make_unique<series>());
+  fam.series.back()->labels = labels;
+  return *fam.series.back();
+}
+
+counter& registry::add_counter(
+  std::string const& name,
+  std::string const& help,
+  labels const& labels)
+{
+  std::lock_guard lock(sync_);
+  auto& s = find_or_add(name, help, "counter", labels);
+  if (!s.counter) {
+    s.counter = std::make_unique<metrics::counter>();
+  }
+  return *s.counter;
+}
+
+gauge& registry::add_gauge(
+  std::string const& name,
+  std::string const& help,
+  labels const& labels)
+{
+  std::lock_guard lock(sync_);
+  auto& s = find_or_add(name, help, "gauge", labels);
+  if (!s.gauge) {
+    s.gauge = std::make_unique<metrics::gauge>();
+  }
+  return *s.gauge;
+}
+
+histogram& registry::add_histogram(
+  std::string const& name,
+  std::string const& help,
+  labels const& labels)
+{
+  std::lock_guard lock(sync_);
+  auto& s = find_or_add(name, help, "histogram", labels);
+  if (!s.histogram) {
+    s.histogram = std::make_unique<metrics::histogram>();
+  }
+  return *s.histogram;
+}
+
+void registry::add_callback(
+  std::string const& name,
+  std::string const& help,
+  labels const& labels,
+  std::function<double()> callback)
+{
+  std::lock_guard lock(sync_);
+  find_or_add(name, help, "gauge", labels).callback = std::move(callback);
+}
+
+void registry::render(std::ostream& os) const
+{
+  std::lock_guard lock(sync_);
+  os.precision(12);
+  for (auto const& [name, fam]: families_) {
+    os << "# HELP " << name << ' ' << fam.help << '\n';
+    os << "# TYPE " << name << ' ' << fam.type << '\n';
+    for (auto const& s: fam.series) {
+      if (s->histogram) {
+        write_histogram(os, name, s->labels, *s->histogram);
+        continue;
+      }
+
+      os << name;
+      write_labels(os, s->labels);
+      if (s->counter) {
+        os << ' ' << s->counter->value() << '\n';
+      } else if (s->gauge) {
+        os << ' ' << s->gauge->value() << '\n';
+      } else if (s->callback) {
+        os << ' ' << s->callback() << '\n';
+      } else {
+        os << " 0\n";
+      }
+    }
+  }
+}
+
+}
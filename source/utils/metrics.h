@@ -0,0 +1,235 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <map>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstdint>
+#include <functional>
+
+namespace sentio::metrics
+{
+
+/**
+ * Name/value pairs that distinguish series of the same metric,
+ * e.g. {{"method", "trip"}} or {{"region", "województwo pomorskie"}}.
+ */
+using labels = std::vector<std::pair<std::string, std::string>>;
+
+namespace detail
+{
+  /**
+   * Number of independent copies of every metric. Each thread records
+   * into the copy picked by its slot, so threads running on different
+   * cores don't bounce the same cache line. Copies are summed up only
+   * when metrics are scraped.
+   */
+  static constexpr size_t shard_count = 16;
+
+  /**
+   * Slot of the calling thread, assigned round-robin on first use.
+   */
+  size_t thread_slot();
+}
+
+/**
+ * A monotonic counter, e.g. number of bytes received.
+ */
+class counter
+{
+public:
+  void add(uint64_t value = 1)
+  {
+    shards_[detail::thread_slot()].value.fetch_add(
+      value, std::memory_order_relaxed);
+  }
+
+  uint64_t value() const;
+
+private:
+  struct alignas(64) shard {
+    std::atomic<uint64_t> value{0};
+  };
+  std::array<shard, detail::shard_count> shards_;
+};
+
+/**
+ * A value that goes up and down, e.g. number of calls in flight.
+ */
+class gauge
+{
+public:
+  void add(int64_t value = 1)
+  {
+    shards_[detail::thread_slot()].value.fetch_add(
+      value, std::memory_order_relaxed);
+  }
+
+  void sub(int64_t value = 1)
+  { add(-value); }
+
+  int64_t value() const;
+
+private:
+  struct alignas(64) shard {
+    std::atomic<int64_t> value{0};
+  };
+  std::array<shard, detail::shard_count> shards_;
+};
+
+/**
+ * A latency histogram with HDR-style log-linear buckets over microseconds.
+ *
+ * Every power of two is split into 4 linear sub-buckets, so recorded values
+ * keep a relative precision of 25% from 1us up to ~19 hours at a fixed cost
+ * of one bucket increment per sample. The fine buckets are folded into the
+ * coarser Prometheus buckets only when scraped.
+ */
+class histogram
+{
+public:
+  static constexpr size_t sub_bucket_bits = 2;
+  static constexpr size_t max_value_bits = 36;
+  static constexpr size_t bucket_count =
+    (max_value_bits - sub_bucket_bits + 1) << sub_bucket_bits;
+
+  struct snapshot {
+    std::array<uint64_t, bucket_count> buckets;
+    uint64_t count;
+    uint64_t sum;  // microseconds
+  };
+
+public:
+  void record(std::chrono::microseconds elapsed);
+
+  template <typename Rep, typename Period>
+  void record(std::chrono::duration<Rep, Period> elapsed)
+  {
+    record(std::chrono::duration_cast<
+      std::chrono::microseconds>(elapsed));
+  }
+
+  snapshot read() const;
+
+public:
+  /**
+   * Index of the bucket that counts the given value, and
+   * the smallest value that no longer falls into a bucket.
+   */
+  static size_t bucket_of(uint64_t value);
+  static uint64_t upper_bound(size_t bucket);
+
+private:
+  struct alignas(64) shard {
+    std::array<std::atomic<uint64_t>, bucket_count> buckets{};
+    std::atomic<uint64_t> sum{0};
+  };
+  std::array<shard, detail::shard_count> shards_;
+};
+
+/**
+ * Records the time elapsed between its construction
+ * and destruction into a histogram.
+ */
+class stopwatch
+{
+public:
+  stopwatch(histogram& target)
+    : target_(target)
+    , started_(std::chrono::steady_clock::now()) {}
+
+  ~stopwatch()
+  { target_.record(std::chrono::steady_clock::now() - started_); }
+
+public: // noncopyable
+  stopwatch(stopwatch const&) = delete;
+  stopwatch& operator=(stopwatch const&) = delete;
+
+private:
+  histogram& target_;
+  std::chrono::steady_clock::time_point started_;
+};
+
+/**
+ * Owns all metrics of the process and renders them in the
+ * Prometheus text exposition format (version 0.0.4).
+ *
+ * Registering a metric takes a lock and is meant to happen once, when
+ * the component that records into it is created. The returned reference
+ * stays valid for the lifetime of the process and recording into it
+ * never takes a lock. Registering the same name and labels twice returns
+ * the same metric.
+ */
+class registry
+{
+public:
+  static registry& instance();
+
+public:
+  counter& add_counter(
+    std::string const& name,
+    std::string const& help,
+    labels const& labels = {});
+
+  gauge& add_gauge(
+    std::string const& name,
+    std::string const& help,
+    labels const& labels = {});
+
+  histogram& add_histogram(
+    std::string const& name,
+    std::string const& help,
+    labels const& labels = {});
+
+  /**
+   * A gauge whose value is read from the callback when scraped,
+   * for state that is already tracked elsewhere, like queue sizes.
+   */
+  void add_callback(
+    std::string const& name,
+    std::string const& help,
+    labels const& labels,
+    std::function<double()> callback);
+
+public:
+  void render(std::ostream& os) const;
+
+private:
+  registry() = default;
+
+private:
+  struct series {
+    metrics::labels labels;
+    std::unique_ptr<metrics::counter> counter;
+    std::unique_ptr<metrics::gauge> gauge;
+    std::unique_ptr<metrics::histogram> histogram;
+    std::function<double()> callback;
+  };
+
+  struct family {
+    std::string help;
+    std::string type;
+    std::vector<std::unique_ptr<registry::series>> series;
+  };
+
+  series& find_or_add(
+    std::string const& name,
+    std::string const& help,
+    std::string const& type,
+    labels const& labels);
+
+private:
+  mutable std::mutex sync_;
+  std::map<std::string, family> families_;
+};
+
+}
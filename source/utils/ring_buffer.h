@@ -0,0 +1,116 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <bit>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+namespace sentio::utils
+{
+
+/**
+ * A bounded multi-producer multi-consumer queue that never blocks.
+ *
+ * Every slot carries a sequence number that tells whether it is free
+ * to write or ready to read for the current lap around the ring, so
+ * producers and consumers only ever contend on one compare-and-swap of
+ * their position. Pushing into a full ring fails instead of waiting.
+ */
+template <typename T>
+class ring_buffer
+{
+public:
+  /**
+   * The capacity is rounded up to the next power of two.
+   */
+  explicit ring_buffer(size_t capacity)
+    : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1)
+    , slots_(std::make_unique<slot[]>(mask_ + 1))
+  {
+    for (size_t i = 0; i <= mask_; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+public: // noncopyable
+  ring_buffer(ring_buffer const&) = delete;
+  ring_buffer& operator=(ring_buffer const&) = delete;
+
+public:
+  /**
+   * Appends a value, returns false if the ring is full.
+   */
+  bool try_push(T&& value)
+  {
+    auto pos = head_.load(std::memory_order_relaxed);
+    slot* target;
+    while (true) {
+      target = &slots_[pos & mask_];
+      auto seq = target->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+            std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    target->value = std::move(value);
+    target->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Takes the oldest value, returns false if the ring is empty.
+   */
+  bool try_pop(T& output)
+  {
+    auto pos = tail_.load(std::memory_order_relaxed);
+    slot* source;
+    while (true) {
+      source = &slots_[pos & mask_];
+      auto seq = source->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+            std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    output = std::move(source->value);
+    source->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const
+  { return mask_ + 1; }
+
+private:
+  struct alignas(64) slot
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  size_t const mask_;
+  std::unique_ptr<slot[]> slots_;
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+}  // namespace sentio::utils
@@ -0,0 +1,182 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "trace.h"
+#include "log.h"
+
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace sentio::trace
+{
+
+namespace // detail
+{
+  thread_local request_trace* g_current = nullptr;
+
+  int64_t microseconds(clock::time_point t)
+  {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      t.time_since_epoch()).count();
+  }
+
+  void write_event(
+    std::ostream& os,
+    const char* name,
+    clock::time_point start,
+    clock::time_point end,
+    size_t tid,
+    uint64_t id)
+  {
+    os << "{\"name\":\"" << name << "\",\"cat\":\"rpc\",\"ph\":\"X\""
+       << ",\"ts\":" << microseconds(start)
+       << ",\"dur\":" << microseconds(end) - microseconds(start)
+       << ",\"pid\":" << ::getpid() << ",\"tid\":" << tid
+       << ",\"args\":{\"trace\":" << id << "}},\n";
+  }
+}
+
+request_trace::request_trace(const char* name, bool sampled)
+  : name_(name)
+  , sampled_(sampled)
+  , started_(clock::now())
+{
+}
+
+void request_trace::record(
+  const char* name,
+  clock::time_point start,
+  clock::time_point end)
+{
+  auto tid = logging::assign_thread_id();
+  std::lock_guard lock(mutex_);
+  spans_.push_back(span_record {
+    .name = name,
+    .start = start,
+    .end = end,
+    .tid = tid
+  });
+}
+
+std::vector<span_record> request_trace::spans() const
+{
+  std::lock_guard lock(mutex_);
+  return spans_;
+}
+
+std::string request_trace::server_timing() const
+{
+  // spans of the same name, like calls of a batch,
+  // are summed up in the order they first appeared.
+  std::vector<std::pair<const char*, clock::duration>> totals;
+  for (auto const& s: spans()) {
+    auto it = std::find_if(totals.begin(), totals.end(),
+      [&s](auto const& t) { return std::strcmp(t.first, s.name) == 0; });
+    if (it == totals.end()) {
+      totals.emplace_back(s.name, s.end - s.start);
+    } else {
+      it->second += s.end - s.start;
+    }
+  }
+
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(3);
+  for (auto const& [name, total]: totals) {
+    if (os.tellp() > 0) {
+      os << ", ";
+    }
+    os << name << ";dur="
+       << std::chrono::duration<double, std::milli>(total).count();
+  }
+  return os.str();
+}
+
+request_trace* current()
+{ return g_current; }
+
+scope::scope(request_trace* trace)
+  : previous_(g_current)
+{ g_current = trace; }
+
+scope::~scope()
+{ g_current = previous_; }
+
+exporter::exporter(
+  std::string const& path,
+  double sample_rate,
+  size_t queue_size)
+  : sample_rate_(sample_rate)
+  , file_(path, std::ios::out | std::ios::trunc)
+  , queue_(queue_size)
+  , exported_(metrics::registry::instance().add_counter(
+      "rpc_traces_exported_total", "Request traces written to the trace file"))
+  , dropped_(metrics::registry::instance().add_counter(
+      "rpc_traces_dropped_total",
+      "Request traces dropped because the export queue was full"))
+{
+  if (!file_.is_open()) {
+    throw std::runtime_error("failed to open trace file " + path);
+  }
+  file_ << "[\n";
+  writer_ = std::thread([this]() { drain(); });
+  infolog << "exporting " << sample_rate * 100
+          << "% of request traces to " << path;
+}
+
+exporter::~exporter()
+{
+  stopping_ = true;
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+}
+
+bool exporter::sample() const
+{
+  if (sample_rate_ <= 0) {
+    return false;
+  }
+  thread_local std::minstd_rand rng(std::random_device{}());
+  return std::uniform_real_distribution<double>(0, 1)(rng) < sample_rate_;
+}
+
+void exporter::submit(request_trace const& trace)
+{
+  auto id = next_id_.fetch_add(1, std::memory_order_relaxed);
+  std::ostringstream os;
+  write_event(os, trace.name(), trace.started(), clock::now(),
+    logging::assign_thread_id(), id);
+  for (auto const& s: trace.spans()) {
+    write_event(os, s.name, s.start, s.end, s.tid, id);
+  }
+
+  if (queue_.try_push(os.str())) {
+    exported_.add();
+  } else {
+    dropped_.add();
+  }
+}
+
+void exporter::drain()
+{
+  std::string events;
+  while (true) {
+    if (queue_.try_pop(events)) {
+      file_ << events;
+      continue;
+    }
+    file_.flush();
+    if (stopping_) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+}  // namespace sentio::trace
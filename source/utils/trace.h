@@ -0,0 +1,180 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+
+#include "metrics.h"
+#include "ring_buffer.h"
+
+namespace sentio::trace
+{
+
+using clock = std::chrono::steady_clock;
+
+/**
+ * A timed section of a request. Names are string literals.
+ */
+struct span_record
+{
+  const char* name;
+  clock::time_point start;
+  clock::time_point end;
+  size_t tid;
+};
+
+/**
+ * Collects the spans of one request, an HTTP request or a WebSocket
+ * message. Calls of a batch run in parallel and record into the same
+ * trace, so recording takes a (normally uncontended) lock.
+ */
+class request_trace
+{
+public:
+  request_trace(const char* name, bool sampled);
+
+public:
+  void record(const char* name, clock::time_point start, clock::time_point end);
+
+  /**
+   * Renders the value of a Server-Timing header, with the total
+   * duration of every span name in milliseconds.
+   */
+  std::string server_timing() const;
+
+  /**
+   * True if the trace is to be exported once the request completes.
+   */
+  bool sampled() const
+  { return sampled_; }
+
+  const char* name() const
+  { return name_; }
+
+  clock::time_point started() const
+  { return started_; }
+
+  std::vector<span_record> spans() const;
+
+private:
+  const char* name_;
+  bool sampled_;
+  clock::time_point started_;
+  mutable std::mutex mutex_;
+  std::vector<span_record> spans_;
+};
+
+/**
+ * The trace of the request served by the calling thread, or nullptr.
+ */
+request_trace* current();
+
+/**
+ * Makes a trace current on the calling thread until the scope ends.
+ * Requests hop between network and executor threads, every hop opens
+ * its own scope. Coroutines must not hold one across a suspension.
+ */
+class scope
+{
+public:
+  explicit scope(request_trace* trace);
+  ~scope();
+
+public: // noncopyable
+  scope(scope const&) = delete;
+  scope& operator=(scope const&) = delete;
+
+private:
+  request_trace* previous_;
+};
+
+/**
+ * Times a section of code into the current trace. Without a current
+ * trace, which is the case for untraced requests, it costs one read
+ * of a thread local.
+ */
+class span
+{
+public:
+  explicit span(const char* name)
+    : trace_(current())
+    , name_(name)
+  {
+    if (trace_ != nullptr) {
+      started_ = clock::now();
+    }
+  }
+
+  ~span()
+  {
+    if (trace_ != nullptr) {
+      trace_->record(name_, started_, clock::now());
+    }
+  }
+
+public: // noncopyable
+  span(span const&) = delete;
+  span& operator=(span const&) = delete;
+
+private:
+  request_trace* trace_;
+  const char* name_;
+  clock::time_point started_;
+};
+
+/**
+ * Writes a sample of request traces to a file in the Chrome trace event
+ * format, which loads in chrome://tracing and Perfetto. The file is one
+ * JSON array that is never closed, as the format allows, so it can be
+ * appended to until the process exits.
+ *
+ * Completed traces are serialized on the thread that finished them and
+ * queued in a lock-free ring drained by a writer thread. When the writer
+ * falls behind, traces are dropped and counted instead of waiting.
+ */
+class exporter
+{
+public:
+  exporter(std::string const& path, double sample_rate, size_t queue_size);
+  ~exporter();
+
+public: // noncopyable
+  exporter(exporter const&) = delete;
+  exporter& operator=(exporter const&) = delete;
+
+public:
+  /**
+   * Decides whether the next request is traced for export.
+   */
+  bool sample() const;
+
+  /**
+   * Queues all spans of a completed request for writing.
+   */
+  void submit(request_trace const& trace);
+
+private:
+  void drain();
+
+private:
+  double sample_rate_;
+  std::ofstream file_;
+  utils::ring_buffer<std::string> queue_;
+  std::atomic<uint64_t> next_id_{1};
+  metrics::counter& exported_;
+  metrics::counter& dropped_;
+  std::atomic<bool> stopping_{false};
+  std::thread writer_;
+};
+
+}  // namespace sentio::trace
@@ -0,0 +1,92 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "rpc/admission.h"
+
+#include <string>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+
+using namespace sentio::rpc;
+using namespace std::chrono_literals;
+
+namespace test
+{
+  config admission_config()
+  {
+    config output{};
+    output.admission.enabled = true;
+    output.admission.method_limit = 10;
+    output.admission.region_limit = 0;
+    output.admission.queue_size = 16;
+    output.admission.queue_timeout = 1min;
+    output.admission.retry_after = 1s;
+    return output;
+  }
+
+  /**
+   * Records the order in which calls are admitted
+   * and keeps their permits until released.
+   */
+  struct admitted_calls
+  {
+    std::vector<std::string> order;
+    std::vector<admission::permit> permits;
+
+    admission::handler_type handler(std::string name)
+    {
+      return [this, name](std::exception_ptr error, admission::permit p) {
+        REQUIRE(!error);
+        order.push_back(name);
+        permits.push_back(std::move(p));
+      };
+    }
+  };
+}
+
+TEST_CASE("Queued calls are admitted before later calls", "[admission]")
+{
+  auto cfg = test::admission_config();
+  boost::asio::io_context io;
+  admission control(cfg);
+  test::admitted_calls calls;
+  auto executor = io.get_executor();
+
+  control.admit({"trip", "", 6}, executor, calls.handler("first"));
+  REQUIRE(calls.order.size() == 1);
+
+  // the large call doesn't fit next to the first one and queues, the
+  // small one would fit, but has to wait behind the large one.
+  control.admit({"trip", "", 8}, executor, calls.handler("large"));
+  control.admit({"trip", "", 2}, executor, calls.handler("small"));
+  REQUIRE(calls.order.size() == 1);
+  REQUIRE(control.queued() == 2);
+
+  calls.permits.clear();
+  io.poll();
+  std::vector<std::string> expected {"first", "large", "small"};
+  REQUIRE(calls.order == expected);
+  REQUIRE(control.queued() == 0);
+}
+
+TEST_CASE("Queued calls don't hold back other methods", "[admission]")
+{
+  auto cfg = test::admission_config();
+  boost::asio::io_context io;
+  admission control(cfg);
+  test::admitted_calls calls;
+  auto executor = io.get_executor();
+
+  control.admit({"trip", "", 6}, executor, calls.handler("first"));
+  control.admit({"trip", "", 8}, executor, calls.handler("large"));
+  control.admit({"distance", "", 1}, executor, calls.handler("distance"));
+  std::vector<std::string> expected {"first", "distance"};
+  REQUIRE(calls.order == expected);
+  REQUIRE(control.queued() == 1);
+
+  calls.permits.clear();
+  io.poll();
+  REQUIRE(calls.order.back() == "large");
+}
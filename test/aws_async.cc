@@ -0,0 +1,68 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "utils/aws_async.h"
+
+#include <thread>
+#include <memory>
+#include <functional>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/io_context.hpp>
+
+namespace net = boost::asio;
+
+namespace
+{
+  struct outcome { int value; };
+
+  /**
+   * Mimics an SDK client, async calls complete on a thread of their own.
+   */
+  struct fake_client
+  {
+    using callback = std::function<void(
+      fake_client const*, int const&, outcome const&,
+      std::shared_ptr<void const> const&)>;
+
+    void DoubleAsync(int const& request, callback const& done) const
+    {
+      std::thread([this, request, done]() {
+        done(this, request, outcome{request * 2}, nullptr);
+      }).detach();
+    }
+  };
+
+  net::awaitable<int> double_value(fake_client const& client, int value)
+  {
+    auto result = co_await sentio::aws::async_call<outcome>(
+      [&](auto const& done) { client.DoubleAsync(value, done); });
+    co_return result.value;
+  }
+}
+
+TEST_CASE("SDK completions resume the awaiting coroutine on its executor", "[aws]")
+{
+  net::io_context context;
+  auto strand = net::make_strand(context);
+  fake_client client;
+
+  int completed = 0;
+  int total = 0;
+  for (int i = 0; i < 100; ++i) {
+    net::co_spawn(strand, double_value(client, i),
+      [&](std::exception_ptr error, int value) {
+        REQUIRE(!error);
+        REQUIRE(strand.running_in_this_thread());
+        total += value;
+        ++completed;
+      });
+  }
+
+  // pending calls keep the context running until they complete
+  context.run();
+  REQUIRE(completed == 100);
+  REQUIRE(total == 9900);
+}
@@ -0,0 +1,54 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "rpc/coalescer.h"
+
+#include <boost/json/parse.hpp>
+#include <boost/asio/io_context.hpp>
+
+using namespace sentio::rpc;
+
+TEST_CASE("Identical calls share a key regardless of member order", "[coalescing]")
+{
+  context ctx{.uid = "account-1", .idp = "firebase", .remote_ep = {}};
+  context other{.uid = "account-2", .idp = "firebase", .remote_ep = {}};
+
+  auto a = boost::json::parse(R"({"from": [52.2, 21.0], "to": {"lat": 1, "lng": 2}})");
+  auto b = boost::json::parse(R"({"to": {"lng": 2, "lat": 1}, "from": [52.2, 21.0]})");
+  auto c = boost::json::parse(R"({"from": [21.0, 52.2], "to": {"lat": 1, "lng": 2}})");
+  auto d = boost::json::parse(R"({"from": "1", "to": 1})");
+  auto e = boost::json::parse(R"({"from": 1, "to": "1"})");
+
+  REQUIRE(coalescer::key_of("distance", ctx, a) == coalescer::key_of("distance", ctx, b));
+  REQUIRE(coalescer::key_of("distance", ctx, a) != coalescer::key_of("distance", ctx, c));
+  REQUIRE(coalescer::key_of("distance", ctx, a) != coalescer::key_of("distance", other, a));
+  REQUIRE(coalescer::key_of("distance", ctx, a) != coalescer::key_of("trip", ctx, a));
+  REQUIRE(coalescer::key_of("distance", ctx, d) != coalescer::key_of("distance", ctx, e));
+}
+
+TEST_CASE("Callers joining a flight receive the outcome of its execution", "[coalescing]")
+{
+  boost::asio::io_context ioc;
+  coalescer flights;
+  context ctx{.uid = "account-1", .idp = "firebase", .remote_ep = {}};
+  auto key = coalescer::key_of("trip", ctx, boost::json::parse(R"({"id": 1})"));
+
+  int delivered = 0;
+  auto handler = [&](std::exception_ptr error, result_t) {
+    REQUIRE(!error);
+    ++delivered;
+  };
+
+  REQUIRE(flights.join(key, ioc.get_executor(), handler));
+  REQUIRE(!flights.join(key, ioc.get_executor(), handler));
+  REQUIRE(!flights.join(key, ioc.get_executor(), handler));
+
+  flights.complete(key, nullptr, result_t());
+  ioc.run();
+  REQUIRE(delivered == 3);
+
+  // completed flights are forgotten, the next call executes again
+  REQUIRE(flights.join(key, ioc.get_executor(), handler));
+}
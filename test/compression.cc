@@ -0,0 +1,76 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "rpc/compression.h"
+
+#include <string>
+#include <zlib.h>
+#include <boost/beast/core/multi_buffer.hpp>
+#include <boost/beast/core/buffers_to_string.hpp>
+
+using sentio::rpc::compression::encoding;
+using sentio::rpc::compression::negotiate;
+
+namespace test
+{
+  std::string inflate(std::string const& compressed, int window_bits)
+  {
+    z_stream stream{};
+    REQUIRE(inflateInit2(&stream, window_bits) == Z_OK);
+
+    std::string output(1 << 20, '\0');
+    stream.next_in = (Bytef*)compressed.data();
+    stream.avail_in = compressed.size();
+    stream.next_out = (Bytef*)output.data();
+    stream.avail_out = output.size();
+    REQUIRE(::inflate(&stream, Z_FINISH) == Z_STREAM_END);
+    output.resize(stream.total_out);
+    inflateEnd(&stream);
+    return output;
+  }
+}
+
+TEST_CASE("Accept-Encoding negotiation", "[compression]")
+{
+  REQUIRE(negotiate("") == encoding::identity);
+  REQUIRE(negotiate("br") == encoding::identity);
+  REQUIRE(negotiate("gzip") == encoding::gzip);
+  REQUIRE(negotiate("deflate, gzip") == encoding::gzip);
+  REQUIRE(negotiate("gzip;q=0.5, deflate") == encoding::deflate);
+  REQUIRE(negotiate("GZIP ; q=1.0") == encoding::gzip);
+  REQUIRE(negotiate("gzip;q=0, deflate;q=0") == encoding::identity);
+  REQUIRE(negotiate("*;q=0.1, gzip;q=0") != encoding::gzip);
+  REQUIRE(negotiate("*;q=0") == encoding::identity);
+  REQUIRE(negotiate("gzip;q=abc") == encoding::identity);
+}
+
+TEST_CASE("Compressed responses round trip", "[compression]")
+{
+  // a body split over several buffers, like a serialized response
+  boost::beast::multi_buffer body;
+  std::string expected;
+  for (int i = 0; i < 2000; ++i) {
+    auto piece = "{\"lat\":\"52." + std::to_string(i) + "\",\"lng\":\"21.0\"},";
+    expected += piece;
+    body.commit(boost::asio::buffer_copy(
+      body.prepare(piece.size()), boost::asio::buffer(piece)));
+  }
+
+  for (int repeat = 0; repeat < 2; ++repeat) {  // reused compressors
+    boost::beast::multi_buffer gzipped;
+    auto size = sentio::rpc::compression::compress(
+      encoding::gzip, 6, body.data(), gzipped);
+    REQUIRE(size == gzipped.size());
+    REQUIRE(size < expected.size());
+    REQUIRE(test::inflate(boost::beast::buffers_to_string(
+      gzipped.data()), MAX_WBITS + 16) == expected);
+
+    boost::beast::multi_buffer deflated;
+    sentio::rpc::compression::compress(
+      encoding::deflate, 1, body.data(), deflated);
+    REQUIRE(test::inflate(boost::beast::buffers_to_string(
+      deflated.data()), MAX_WBITS) == expected);
+  }
+}
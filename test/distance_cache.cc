@@ -0,0 +1,116 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "routing/distance_cache.h"
+
+#include <chrono>
+#include <vector>
+
+using sentio::routing::travel_cost;
+using sentio::routing::distance_cache;
+using sentio::spacial::coordinates;
+namespace metrics = sentio::metrics;
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Distances are cached per region until they expire", "[distance]")
+{
+  distance_cache cache(1024 * 1024, 1h);
+  auto now = distance_cache::clock::now();
+  coordinates from(52.2297, 21.0122);
+  coordinates to(52.4064, 16.9252);
+
+  REQUIRE(!cache.find("poland", from, to, now).has_value());
+  cache.insert("poland", from, to, travel_cost{310000, 11000s}, now);
+
+  auto found = cache.find("poland", from, to, now);
+  REQUIRE(found.has_value());
+  REQUIRE(found->distance == 310000);
+  REQUIRE(found->duration == 11000s);
+
+  REQUIRE(!cache.find("germany", from, to, now).has_value());
+  REQUIRE(!cache.find("poland", to, from, now).has_value());
+  REQUIRE(!cache.find("poland", from, to, now + 1h).has_value());
+}
+
+TEST_CASE("Coordinates are matched to about a meter", "[distance]")
+{
+  distance_cache cache(1024 * 1024, 1h);
+  coordinates from(52.2297, 21.0122);
+  coordinates to(52.4064, 16.9252);
+  cache.insert("poland", from, to, travel_cost{310000, 11000s});
+
+  coordinates nearby(52.229701, 21.012202);
+  REQUIRE(cache.find("poland", nearby, to).has_value());
+
+  coordinates further(52.22975, 21.0122);
+  REQUIRE(!cache.find("poland", further, to).has_value());
+}
+
+TEST_CASE("The cache does not grow beyond its memory cap", "[distance]")
+{
+  distance_cache cache(
+    distance_cache::entry_size * distance_cache::shard_count * 4, 1h);
+  REQUIRE(cache.capacity() == distance_cache::shard_count * 4);
+
+  coordinates to(52.4064, 16.9252);
+  for (int i = 0; i < 1000; ++i) {
+    coordinates from(50.0 + i * 0.001, 20.0);
+    cache.insert("poland", from, to, travel_cost{i, 1s});
+  }
+  REQUIRE(cache.size() == cache.capacity());
+
+  // the latest entry replaced an older one in its shard
+  coordinates latest(50.0 + 999 * 0.001, 20.0);
+  auto found = cache.find("poland", latest, to);
+  REQUIRE(found.has_value());
+  REQUIRE(found->distance == 999);
+}
+
+TEST_CASE("Recently used distances survive eviction", "[distance]")
+{
+  distance_cache cache(
+    distance_cache::entry_size * distance_cache::shard_count * 4, 1h);
+
+  coordinates to(52.4064, 16.9252);
+  coordinates hot(50.0, 20.0);
+  cache.insert("poland", hot, to, travel_cost{1, 1s});
+
+  for (int i = 1; i < 1000; ++i) {
+    REQUIRE(cache.find("poland", hot, to).has_value());
+    coordinates from(50.0 + i * 0.001, 20.0);
+    cache.insert("poland", from, to, travel_cost{i, 1s});
+  }
+  REQUIRE(cache.find("poland", hot, to).has_value());
+}
+
+TEST_CASE("Matrices count hits only when served from the cache", "[distance]")
+{
+  distance_cache cache(1024 * 1024, 1h);
+  auto& hits = metrics::registry::instance().add_counter(
+    "osrm_distance_cache_hits_total", "");
+  auto& misses = metrics::registry::instance().add_counter(
+    "osrm_distance_cache_misses_total", "");
+
+  std::vector<coordinates> sources { {52.2297, 21.0122}, {50.0647, 19.9450} };
+  std::vector<coordinates> destinations { {52.4064, 16.9252} };
+  cache.insert("poland", sources[0], destinations[0],
+    travel_cost{310000, 11000s});
+
+  auto hits_before = hits.value();
+  auto misses_before = misses.value();
+  REQUIRE(!cache.find_all("poland", sources, destinations).has_value());
+  REQUIRE(hits.value() == hits_before);
+  REQUIRE(misses.value() == misses_before + 2);
+
+  cache.insert("poland", sources[1], destinations[0],
+    travel_cost{400000, 14000s});
+  auto matrix = cache.find_all("poland", sources, destinations);
+  REQUIRE(matrix.has_value());
+  REQUIRE(matrix->size() == 2);
+  REQUIRE((*matrix)[0].distance == 310000);
+  REQUIRE((*matrix)[1].distance == 400000);
+  REQUIRE(hits.value() == hits_before + 2);
+}
@@ -0,0 +1,104 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "utils/json_encode.h"
+
+#include <vector>
+#include <string>
+#include <optional>
+
+namespace test
+{
+  struct point 
+  {
+    double lat, lng;
+  };
+
+  struct place 
+  {
+    int64_t id;
+    point where;
+    std::string name;
+    std::optional<std::string> note;
+    std::vector<int> tags;
+  };
+
+  constexpr auto json_fields(point const*)
+  {
+    using sentio::json::field;
+    return std::make_tuple(
+      field("lat", &point::lat),
+      field("lng", &point::lng));
+  }
+
+  constexpr auto json_fields(place const*)
+  {
+    using sentio::json::field;
+    using sentio::json::nonempty_field;
+    return std::make_tuple(
+      field("id", &place::id),
+      field("where", &place::where),
+      field("name", [](place const& p) -> std::string const& { return p.name; }),
+      field("note", &place::note),
+      nonempty_field("tags", &place::tags));
+  }
+
+  template <typename T>
+  std::string to_string(T const& value, 
+    sentio::json::writer::numbers format = sentio::json::writer::numbers::quoted)
+  {
+    std::string output;
+    auto buffer = boost::asio::dynamic_buffer(output);
+    {
+      sentio::json::writer w(buffer, format);
+      write(w, value);
+    }
+    return output;
+  }
+}
+
+TEST_CASE("Described types are written field by field", "[json]")
+{
+  test::place p { 
+    .id = 42, 
+    .where = {54.352025, 18.6466384}, 
+    .name = "Długa", 
+    .note = std::nullopt, 
+    .tags = {} };
+
+  REQUIRE(test::to_string(p) == 
+    R"({"id":"42","where":{"lat":"54.352025","lng":"18.646638"},"name":"Długa"})");
+
+  p.note = "ring twice";
+  p.tags = {1, 2};
+  REQUIRE(test::to_string(p, sentio::json::writer::numbers::plain) == 
+    R"({"id":42,"where":{"lat":54.352025,"lng":18.646638},)"
+    R"("name":"Długa","note":"ring twice","tags":[1,2]})");
+}
+
+TEST_CASE("Strings are escaped", "[json]")
+{
+  REQUIRE(test::to_string(std::string("a\"b\\c\nd\x01")) == 
+    R"("a\"b\\c\nd\u0001")");
+}
+
+TEST_CASE("Large documents span multiple flushes", "[json]")
+{
+  std::vector<std::string> values(1000, std::string(100, 'x'));
+  auto output = test::to_string(values);
+  REQUIRE(output.size() == 2 + 1000 * 102 + 999);
+  REQUIRE(output.front() == '[');
+  REQUIRE(output.back() == ']');
+}
+
+TEST_CASE("Property trees are written like write_json", "[json]")
+{
+  json_t tree, list;
+  tree.add("a.b", 1);
+  list.push_back(std::make_pair("", json_t("x")));
+  list.push_back(std::make_pair("", json_t("y")));
+  tree.add_child("list", list);
+  REQUIRE(test::to_string(tree) == R"({"a":{"b":"1"},"list":["x","y"]})");
+}
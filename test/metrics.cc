@@ -0,0 +1,76 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "utils/metrics.h"
+
+#include <thread>
+#include <vector>
+#include <sstream>
+
+TEST_CASE("Histogram buckets cover all values", "[metrics]")
+{
+  using sentio::metrics::histogram;
+
+  for (uint64_t value = 0; value < (1 << 20); ++value) {
+    size_t bucket = histogram::bucket_of(value);
+    REQUIRE(value < histogram::upper_bound(bucket));
+    if (bucket != 0) {
+      REQUIRE(value >= histogram::upper_bound(bucket - 1));
+    }
+  }
+
+  // values beyond the range end up in the last bucket
+  REQUIRE(histogram::bucket_of(uint64_t(1) << 40) == 
+    histogram::bucket_count - 1);
+}
+
+TEST_CASE("Concurrent recording is not lossy", "[metrics]")
+{
+  using namespace std::chrono_literals;
+  sentio::metrics::histogram h;
+  sentio::metrics::counter c;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < 10000; ++j) {
+        h.record(1ms);
+        c.add(2);
+      }
+    });
+  }
+  for (auto& t: threads) {
+    t.join();
+  }
+
+  auto snapshot = h.read();
+  REQUIRE(snapshot.count == 80000);
+  REQUIRE(snapshot.sum == 80000 * 1000);
+  REQUIRE(c.value() == 160000);
+}
+
+TEST_CASE("Prometheus text rendering", "[metrics]")
+{
+  using namespace std::chrono_literals;
+  auto& registry = sentio::metrics::registry::instance();
+
+  auto& h = registry.add_histogram(
+    "test_duration_seconds", "test latency", {{"method", "trip"}});
+  h.record(3ms);
+  h.record(400us);
+
+  // same name and labels yield the same series
+  REQUIRE(&h == &registry.add_histogram(
+    "test_duration_seconds", "", {{"method", "trip"}}));
+
+  std::stringstream ss;
+  registry.render(ss);
+  auto output = ss.str();
+
+  REQUIRE(output.find("# TYPE test_duration_seconds histogram") != std::string::npos);
+  REQUIRE(output.find("test_duration_seconds_bucket{method=\"trip\",le=\"0.001\"} 1") != std::string::npos);
+  REQUIRE(output.find("test_duration_seconds_bucket{method=\"trip\",le=\"0.005\"} 2") != std::string::npos);
+  REQUIRE(output.find("test_duration_seconds_count{method=\"trip\"} 2") != std::string::npos);
+}
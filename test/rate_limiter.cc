@@ -0,0 +1,87 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "rpc/rate_limiter.h"
+
+using namespace sentio::rpc;
+using namespace std::chrono_literals;
+
+namespace test
+{
+  std::unordered_map<std::string, provider_limits> limited_config()
+  {
+    std::unordered_map<std::string, provider_limits> output;
+    output.emplace("XpressDelivery", provider_limits {
+      .account = rate_limit{.rate = 10, .burst = 5},
+      .methods = {{"trip", rate_limit{.rate = 1, .burst = 2}}}
+    });
+    return output;
+  }
+}
+
+TEST_CASE("Account buckets allow bursts and then the sustained rate", "[rate_limit]")
+{
+  auto cfg = test::limited_config();
+  rate_limiter limiter(cfg);
+  context ctx{.uid = "account-1", .idp = "XpressDelivery", .remote_ep = {}};
+  auto now = rate_limiter::clock::now();
+
+  for (int i = 0; i < 5; ++i) {
+    REQUIRE(!limiter.acquire(ctx, now).has_value());
+  }
+  auto wait = limiter.acquire(ctx, now);
+  REQUIRE(wait.has_value());
+  REQUIRE(*wait == 1s);
+
+  // one token every 100ms
+  REQUIRE(!limiter.acquire(ctx, now + 100ms).has_value());
+  REQUIRE(limiter.acquire(ctx, now + 100ms).has_value());
+
+  // other accounts and providers are not affected
+  context other{.uid = "account-2", .idp = "XpressDelivery", .remote_ep = {}};
+  REQUIRE(!limiter.acquire(other, now).has_value());
+  context firebase{.uid = "account-1", .idp = "firebase", .remote_ep = {}};
+  for (int i = 0; i < 100; ++i) {
+    REQUIRE(!limiter.acquire(firebase, now).has_value());
+  }
+}
+
+TEST_CASE("Method buckets are separate from account buckets", "[rate_limit]")
+{
+  auto cfg = test::limited_config();
+  rate_limiter limiter(cfg);
+  context ctx{.uid = "account-1", .idp = "XpressDelivery", .remote_ep = {}};
+  auto now = rate_limiter::clock::now();
+
+  REQUIRE(!limiter.acquire(ctx, "trip", now).has_value());
+  REQUIRE(!limiter.acquire(ctx, "trip", now).has_value());
+  auto wait = limiter.acquire(ctx, "trip", now);
+  REQUIRE(wait.has_value());
+  REQUIRE(*wait == 1s);
+
+  REQUIRE(!limiter.acquire(ctx, "geocode", now).has_value());
+  REQUIRE(!limiter.acquire(ctx, now).has_value());
+  REQUIRE(!limiter.acquire(ctx, "trip", now + 1s).has_value());
+}
+
+TEST_CASE("Refilled buckets are evicted", "[rate_limit]")
+{
+  auto cfg = test::limited_config();
+  rate_limiter limiter(cfg);
+  auto now = rate_limiter::clock::now();
+
+  for (int i = 0; i < 1000; ++i) {
+    context ctx{.uid = std::to_string(i), .idp = "XpressDelivery", .remote_ep = {}};
+    limiter.acquire(ctx, now);
+  }
+  REQUIRE(limiter.size() == 1000);
+
+  // new accounts sweep the shards they land in, idle buckets are full by now
+  for (int i = 0; i < 1000; ++i) {
+    context ctx{.uid = "new-" + std::to_string(i), .idp = "XpressDelivery", .remote_ep = {}};
+    limiter.acquire(ctx, now + 1min);
+  }
+  REQUIRE(limiter.size() == 1000);
+}
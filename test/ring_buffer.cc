@@ -0,0 +1,68 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "utils/ring_buffer.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using sentio::utils::ring_buffer;
+
+TEST_CASE("Full rings reject values instead of blocking", "[ring_buffer]")
+{
+  ring_buffer<std::string> ring(3);
+  REQUIRE(ring.capacity() == 4);
+
+  for (int i = 0; i < 4; ++i) {
+    REQUIRE(ring.try_push(std::to_string(i)));
+  }
+  REQUIRE(!ring.try_push("overflow"));
+
+  std::string value;
+  REQUIRE(ring.try_pop(value));
+  REQUIRE(value == "0");
+  REQUIRE(ring.try_push("4"));
+
+  for (int i = 1; i <= 4; ++i) {
+    REQUIRE(ring.try_pop(value));
+    REQUIRE(value == std::to_string(i));
+  }
+  REQUIRE(!ring.try_pop(value));
+}
+
+TEST_CASE("Values pushed concurrently are popped exactly once", "[ring_buffer]")
+{
+  ring_buffer<int> ring(1024);
+  constexpr int producers = 4;
+  constexpr int per_producer = 10000;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&ring, p]() {
+      for (int i = 0; i < per_producer; ++i) {
+        while (!ring.try_push(p * per_producer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  std::vector<int> seen(producers * per_producer, 0);
+  int value, popped = 0;
+  while (popped < producers * per_producer) {
+    if (ring.try_pop(value)) {
+      ++seen[value];
+      ++popped;
+    }
+  }
+  for (auto& t: threads) {
+    t.join();
+  }
+
+  for (auto count: seen) {
+    REQUIRE(count == 1);
+  }
+}
@@ -0,0 +1,23 @@
+-- Copyright (C) Karim Agha - All Rights Reserved
+-- Unauthorized copying of this file, via any medium is strictly prohibited
+-- Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+-- wrk script that sends geocode JSON-RPC calls for a few
+-- partially typed addresses in Bialystok (podlaskie).
+
+local queries = { "Wiejs", "Wiejska 4", "Lipowa", "Lipowa 12", "Sienkiewicza 8" }
+local counter = 0
+
+wrk.method = "POST"
+wrk.headers["Content-Type"] = "application/json"
+wrk.headers["Authorization"] = "Bearer " .. os.getenv("TOKEN")
+
+request = function()
+  counter = counter + 1
+  local text = queries[(counter % #queries) + 1]
+  local body = string.format(
+    '{"jsonrpc":"2.0","id":"%d","method":"geocode","params":' ..
+    '{"text":"%s","location":{"latitude":53.1325,"longitude":23.1688}}}',
+    counter, text)
+  return wrk.format(nil, "/", nil, body)
+end
@@ -0,0 +1,40 @@
+#!/bin/bash
+# Copyright (C) Karim Agha - All Rights Reserved
+# Unauthorized copying of this file, via any medium is strictly prohibited
+# Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#
+# Measures the request throughput of a running turbo_server instance
+# using wrk (https://github.com/wg/wrk). Run it once against a server
+# with rpc.sharding.enabled = false and once with sharding enabled to
+# compare the single completion queue with per-core SO_REUSEPORT shards.
+#
+# usage: throughput.sh <host:port> [jwt-token]
+#
+#  - without a token only the /healthcheck endpoint is benchmarked, this
+#    measures the raw accept/parse/write path of the server.
+#  - with a token, geocode JSON-RPC calls are benchmarked as well.
+#
+
+set -e
+
+TARGET=${1:?"usage: $0 <host:port> [jwt-token]"}
+TOKEN=${2:-}
+THREADS=${THREADS:-$(nproc)}
+CONNECTIONS=${CONNECTIONS:-256}
+DURATION=${DURATION:-30s}
+SCRIPTDIR=$(dirname "$0")
+
+echo "== healthcheck, keep-alive connections"
+wrk -t"$THREADS" -c"$CONNECTIONS" -d"$DURATION" --latency \
+  "http://$TARGET/healthcheck"
+
+echo "== healthcheck, new connection per request"
+wrk -t"$THREADS" -c"$CONNECTIONS" -d"$DURATION" --latency \
+  -H "Connection: close" "http://$TARGET/healthcheck"
+
+if [ -n "$TOKEN" ]; then
+  echo "== geocode json-rpc"
+  TOKEN="$TOKEN" wrk -t"$THREADS" -c"$CONNECTIONS" -d"$DURATION" --latency \
+    -s "$SCRIPTDIR/geocode.lua" "http://$TARGET/"
+fi
@@ -0,0 +1,54 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "rpc/token_cache.h"
+
+#include <string>
+
+using sentio::rpc::identity;
+using sentio::rpc::token_cache;
+
+TEST_CASE("Verified tokens are cached until they expire", "[auth]")
+{
+  token_cache cache(1024);
+  auto now = token_cache::clock::now();
+  auto expires = now + std::chrono::hours(1);
+
+  REQUIRE(!cache.find("token", 1).has_value());
+  cache.insert("token", identity{"+48500100200", "firebase"}, expires, 1);
+
+  auto found = cache.find("token", 1);
+  REQUIRE(found.has_value());
+  REQUIRE(found->upn == "+48500100200");
+  REQUIRE(found->idp == "firebase");
+
+  REQUIRE(!cache.find("token2", 1).has_value());
+  REQUIRE(!cache.find("token", 1, expires).has_value());
+}
+
+TEST_CASE("Rotating keys invalidates cached tokens", "[auth]")
+{
+  token_cache cache(1024);
+  auto expires = token_cache::clock::now() + std::chrono::hours(1);
+
+  cache.insert("token", identity{"user", "firebase"}, expires, 1);
+  REQUIRE(cache.find("token", 1).has_value());
+  REQUIRE(!cache.find("token", 2).has_value());
+
+  cache.insert("token", identity{"user", "firebase"}, expires, 2);
+  REQUIRE(cache.find("token", 2).has_value());
+  REQUIRE(cache.size() == 1);
+}
+
+TEST_CASE("Token cache stays within its capacity", "[auth]")
+{
+  token_cache cache(64);
+  auto expires = token_cache::clock::now() + std::chrono::hours(1);
+  for (int i = 0; i < 10000; ++i) {
+    cache.insert(std::to_string(i), identity{"user", "idp"}, expires, 1);
+  }
+  REQUIRE(cache.size() <= 64);
+  REQUIRE(cache.find("9999", 1).has_value());
+}
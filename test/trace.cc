@@ -0,0 +1,78 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include "catch.h"
+#include "utils/trace.h"
+
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstring>
+
+using namespace std::chrono_literals;
+namespace trace = sentio::trace;
+
+TEST_CASE("Spans outside of a trace record nothing", "[trace]")
+{
+  REQUIRE(trace::current() == nullptr);
+  trace::span section("untraced");
+  REQUIRE(trace::current() == nullptr);
+}
+
+TEST_CASE("Spans record into the trace of their scope", "[trace]")
+{
+  trace::request_trace outer("outer", false);
+  trace::request_trace inner("inner", false);
+  {
+    trace::scope traced(&outer);
+    trace::span section("first");
+    {
+      trace::scope nested(&inner);
+      REQUIRE(trace::current() == &inner);
+      trace::span other("second");
+    }
+    REQUIRE(trace::current() == &outer);
+  }
+  REQUIRE(trace::current() == nullptr);
+
+  auto spans = outer.spans();
+  REQUIRE(spans.size() == 1);
+  REQUIRE(std::strcmp(spans[0].name, "first") == 0);
+  REQUIRE(spans[0].end >= spans[0].start);
+
+  REQUIRE(inner.spans().size() == 1);
+  REQUIRE(std::strcmp(inner.spans()[0].name, "second") == 0);
+}
+
+TEST_CASE("Server timing sums up spans of the same name", "[trace]")
+{
+  trace::request_trace tr("request", false);
+  auto t0 = trace::clock::now();
+  tr.record("parse", t0, t0 + 1ms);
+  tr.record("invoke", t0 + 1ms, t0 + 3ms);
+  tr.record("invoke", t0 + 1ms, t0 + 4ms);
+  tr.record("serialize", t0 + 4ms, t0 + 4500us);
+
+  REQUIRE(tr.server_timing() ==
+    "parse;dur=1.000, invoke;dur=5.000, serialize;dur=0.500");
+}
+
+TEST_CASE("Calls of a batch record concurrently", "[trace]")
+{
+  trace::request_trace tr("batch", false);
+  std::vector<std::thread> calls;
+  for (int i = 0; i < 8; ++i) {
+    calls.emplace_back([&tr]() {
+      trace::scope traced(&tr);
+      for (int j = 0; j < 100; ++j) {
+        trace::span section("invoke");
+      }
+    });
+  }
+  for (auto& call: calls) {
+    call.join();
+  }
+  REQUIRE(tr.spans().size() == 800);
+}
@@ -0,0 +1,139 @@
+// Copyright (C) Karim Agha - All Rights Reserved
+// Unauthorized copying of this file, via any medium is strictly prohibited
+// Proprietary and confidential. Authored by Karim Agha <karim@sentio.cloud>
+
+#include <chrono>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <functional>
+
+#include <boost/json/parse.hpp>
+#include <boost/json/monotonic_resource.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include "routing/trip.h"
+#include "spacial/coords.h"
+#include "utils/json_decode.h"
+
+using namespace sentio;
+
+/**
+ * A JSON-RPC trip request with the given number of intermediate
+ * waypoints, shaped like the ones sent by the mobile clients.
+ * Numbers are sent as strings when @c quoted is set, this is how
+ * clients echo back buildings they got from the geocoder.
+ */
+std::string make_trip_request(size_t waypoints, bool quoted)
+{
+  auto number = [quoted](auto value) {
+    std::ostringstream ss;
+    ss.precision(8);
+    if (quoted) {
+      ss << '"' << value << '"';
+    } else {
+      ss << value;
+    }
+    return ss.str();
+  };
+
+  auto waypoint = [&](size_t id) {
+    std::ostringstream ss;
+    ss << R"({"building":{"id":)" << number(100000 + id)
+       << R"(,"coords":{"latitude":)" << number(54.35 + id * 0.0001)
+       << R"(,"longitude":)" << number(18.64 + id * 0.0001)
+       << R"(},"city":"Gdańsk","street":"Długa","number":")" << id
+       << R"(","zipcode":"80-831"},"phone":"+48500100200",)"
+       << R"("input_method":"text","notes":"second floor, ring twice"})";
+    return ss.str();
+  };
+
+  std::ostringstream ss;
+  ss << R"({"jsonrpc":"2.0","id":"1","method":"trip","params":{)"
+     << R"("location":{"latitude":)" << number(54.35)
+     << R"(,"longitude":)" << number(18.64) << "},"
+     << R"("starting_point":)" << waypoint(0) << ','
+     << R"("final_point":)" << waypoint(0) << ','
+     << R"("waypoints":[)";
+  for (size_t i = 1; i <= waypoints; ++i) {
+    ss << (i == 1 ? "" : ",") << waypoint(i);
+  }
+  ss << "]}}";
+  return ss.str();
+}
+
+/**
+ * Runs @c fn repeatedly and prints the mean time per iteration.
+ */
+void measure(std::string const& name, size_t iterations, std::function<size_t()> fn)
+{
+  size_t checksum = 0;
+  for (size_t i = 0; i < iterations / 10; ++i) {
+    checksum += fn();  // warm up caches and the allocator
+  }
+
+  auto started = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    checksum += fn();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - started;
+  auto micros = std::chrono::duration<double, std::micro>(elapsed).count();
+
+  std::cout << name << ": " << micros / iterations 
+            << " us/request [checksum: " << checksum << "]" << std::endl;
+}
+
+/**
+ * The request path before typed decoding: read_json into a property 
+ * tree, then convert every waypoint out of the tree.
+ */
+size_t decode_ptree(std::string const& body)
+{
+  json_t request;
+  std::stringstream ss(body);
+  boost::property_tree::read_json(ss, request);
+
+  auto const& params = request.get_child("params");
+  spacial::coordinates location(params.get_child("location"));
+  routing::unoptimized_trip trip(params);
+  return trip.size() + (location.empty() ? 0 : 1);
+}
+
+/**
+ * The current request path: parse in place into an arena,
+ * then decode straight into the typed trip.
+ */
+size_t decode_typed(std::string const& body)
+{
+  boost::json::error_code ec;
+  auto request = boost::json::parse(body, ec,
+    boost::json::make_shared_resource<boost::json::monotonic_resource>());
+  if (ec) {
+    throw std::invalid_argument("parse error");
+  }
+
+  auto const& params = json::at(request, "params");
+  auto location = boost::json::value_to<spacial::coordinates>(
+    json::at(params, "location"));
+  auto trip = boost::json::value_to<routing::unoptimized_trip>(params);
+  return trip.size() + (location.empty() ? 0 : 1);
+}
+
+int main(int argc, const char** argv)
+{
+  size_t waypoints = argc > 1 ? std::stoul(argv[1]) : 300;
+  size_t iterations = argc > 2 ? std::stoul(argv[2]) : 1000;
+
+  for (bool quoted: {false, true}) {
+    auto body = make_trip_request(waypoints, quoted);
+    std::cout << "trip request with " << waypoints << " waypoints, "
+              << body.size() << " bytes, numbers " 
+              << (quoted ? "as strings" : "as numbers") << std::endl;
+
+    measure("  property_tree", iterations, 
+      [&body]() { return decode_ptree(body); });
+    measure("  boost.json typed", iterations, 
+      [&body]() { return decode_typed(body); });
+  }
+  return 0;
+}